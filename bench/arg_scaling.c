@@ -0,0 +1,59 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include "../src/lispy.h"
+
+/*
+  Cost per argument of builtin calls as the argument count grows.
+  Each call is built as an S-Expression and evaluated once, and only
+  the evaluation is timed. A flat ns/arg column means the builtin
+  consumes its arguments in linear time.
+*/
+
+/* (join {0} {1} ... {n-1}) */
+static lval* join_call(int n) {
+    lval* s = lval_add(lval_sexpr(), lval_sym("join"));
+    for (int i = 0; i < n; i++) {
+        s = lval_add(s, lval_add(lval_qexpr(), lval_num(i)));
+    }
+    return s;
+}
+
+/* (head {0 1 ... n-1}) */
+static lval* head_call(int n) {
+    lval* q = lval_qexpr();
+    for (int i = 0; i < n; i++) { q = lval_add(q, lval_num(i)); }
+    return lval_add(lval_add(lval_sexpr(), lval_sym("head")), q);
+}
+
+/* (+ 0 1 ... n-1) */
+static lval* add_call(int n) {
+    lval* s = lval_add(lval_sexpr(), lval_sym("+"));
+    for (int i = 0; i < n; i++) { s = lval_add(s, lval_num(i)); }
+    return s;
+}
+
+static void run(lenv* e, const char* name, lval* (*call)(int), int n) {
+    lval* s = call(n);
+
+    double start = bench_now();
+    lval* x = lval_eval(e, s);
+    double elapsed = bench_now() - start;
+
+    printf("%-5s %8d args  %7.2f ns/arg\n", name, n, elapsed * 1e9 / n);
+    lval_del(x);
+}
+
+int main(void) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    int sizes[] = { 10000, 100000, 1000000 };
+    for (int i = 0; i < 3; i++) { run(e, "join", join_call, sizes[i]); }
+    for (int i = 0; i < 3; i++) { run(e, "head", head_call, sizes[i]); }
+    for (int i = 0; i < 3; i++) { run(e, "+", add_call, sizes[i]); }
+
+    lenv_del(e);
+    intern_cleanup();
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/lispy.h"
+
+/*
+  mpc AST allocation: parse a 10 MB source file into one AST and
+  free it, with every node, tag and child array from malloc and then
+  with the AST arena. Parse and free are timed apart, since the
+  arena turns the free into a handful of block releases.
+*/
+
+enum { SOURCE_KB = 10 * 1024 };
+
+static const char* forms[] = {
+    "(def {fact} (\\ {n acc} {if (<= n 1) {acc} {fact (- n 1) (* n acc)}}))\n",
+    "(+ (* 2 3) (- 10 4) (/ 20 5) (* (+ 1 2) (- 7 3)) (% 17 5) (^ 2 10))\n",
+    "(len (join (tail {1 2 3 4 5 6 7 8}) (head {9 10 11}) (list x y)))\n",
+    "(def {pairs} (list (head big) (tail big) {x y z} (eval {list 1 2 3})))\n",
+    "  (if (== (len xs) 0) {nil} {join (head xs) (rest (tail xs))})\n",
+};
+
+enum { FORMS = sizeof forms / sizeof forms[0] };
+
+static FILE* make_source(size_t kb) {
+    FILE* f = tmpfile();
+    for (size_t n = 0, i = 0; n < kb * 1024; i++) {
+        fputs(forms[i % FORMS], f);
+        n += strlen(forms[i % FORMS]);
+    }
+    return f;
+}
+
+static long count_nodes(mpc_ast_t* a) {
+    long n = 1;
+    for (int i = 0; i < a->children_num; i++) { n += count_nodes(a->children[i]); }
+    return n;
+}
+
+static void run(FILE* f, int arena) {
+    mpc_ast_arena_set(arena);
+    rewind(f);
+
+    mpc_result_t r;
+    double start = bench_now();
+    if (!mpc_parse_file("<bench>", f, lispy_parser(), &r)) {
+        mpc_err_print(r.error);
+        mpc_err_delete(r.error);
+        exit(1);
+    }
+    double parse = bench_now() - start;
+    long nodes = count_nodes(r.output);
+
+    start = bench_now();
+    mpc_ast_delete(r.output);
+    double del = bench_now() - start;
+
+    printf("%-6s  parse %6.2f s  free %8.4f s  (%ld nodes)\n",
+           arena ? "arena" : "malloc", parse, del, nodes);
+}
+
+int main(void) {
+    FILE* f = make_source(SOURCE_KB);
+    run(f, 0);
+    run(f, 1);
+    fclose(f);
+    lispy_parser_cleanup();
+    intern_cleanup();
+    return 0;
+}
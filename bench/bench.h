@@ -0,0 +1,123 @@
+#ifndef bench_h
+#define bench_h
+
+#define _POSIX_C_SOURCE 200112L
+/* For syscall, to reach perf_event_open */
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <string.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Monotonic wall clock in seconds */
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Current resident set size in kilobytes. Linux exposes it in
+ * /proc/self/statm; elsewhere fall back to the peak from getrusage.
+ **/
+static inline long bench_rss_kb(void) {
+    long size, resident;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        int n = fscanf(f, "%ld %ld", &size, &resident);
+        fclose(f);
+        if (n == 2) { return resident * (sysconf(_SC_PAGESIZE) / 1024); }
+    }
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/* Peak resident set size in kilobytes */
+static inline long bench_peak_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/* Opens the hardware counter 'config' for user space in this process */
+static inline int bench_counter_open(unsigned long long config) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof attr;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Hardware counter for mispredicted branches in this process, or -1
+ * where the kernel or the machine will not provide one. Start it
+ * with bench_counter_start and read the count since then with
+ * bench_counter_read.
+ **/
+static inline int bench_branch_misses(void) {
+#ifdef __linux__
+    return bench_counter_open(PERF_COUNT_HW_BRANCH_MISSES);
+#else
+    return -1;
+#endif
+}
+
+/* Hardware counter for retired instructions, used the same way */
+static inline int bench_instructions(void) {
+#ifdef __linux__
+    return bench_counter_open(PERF_COUNT_HW_INSTRUCTIONS);
+#else
+    return -1;
+#endif
+}
+
+static inline void bench_counter_start(int fd) {
+#ifdef __linux__
+    if (fd < 0) { return; }
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+static inline long long bench_counter_read(int fd) {
+    long long n = -1;
+#ifdef __linux__
+    if (fd < 0) { return -1; }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &n, sizeof n) != sizeof n) { n = -1; }
+#endif
+    return n;
+}
+
+/**
+ * The time stamp counter: cycles at the nominal clock rate, read
+ * without the kernel, so there even when hardware counters are not.
+ * -1 on machines other than x86.
+ **/
+static inline long long bench_tsc(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return (long long)__rdtsc();
+#else
+    return -1;
+#endif
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include "../src/lispy.h"
+#include "../src/vm.h"
+#include "../src/fold.h"
+
+/*
+  Constant folding on forms with constant subexpressions. Each form
+  is read once, then compiled and run ROUNDS times as written and
+  again after folding.
+*/
+
+enum { ROUNDS = 200000 };
+
+static const char* forms[] = {
+    "(+ 1 (* 2 3))",
+    "(+ x (* 2 3) (- 10 4) (/ 20 5) (% 17 5) (^ 2 10) (len {1 2 3}))",
+    "(* y (len (tail {1 2 3 4 5 6})) (len (join {1 2} {3})))",
+    "(if (> x (* 2 2)) {+ x 1} {- x 1})",
+};
+
+enum { FORMS = sizeof forms / sizeof forms[0] };
+
+static double run(lenv* e, lval* v, long* sum) {
+    lchunk* c = lval_compile(v);
+    double start = bench_now();
+    for (int i = 0; i < ROUNDS; i++) {
+        lval* x = lvm_run(e, c);
+        if (lval_type(x) == LVAL_NUM) { *sum += lval_long(x); }
+        lval_del(x);
+    }
+    double elapsed = bench_now() - start;
+    lchunk_del(c);
+    return elapsed;
+}
+
+int main(void) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* k = lval_sym("x"); lval* v = lval_num(6);
+    lenv_put(e, k, v); lval_del(k); lval_del(v);
+    k = lval_sym("y"); v = lval_num(7);
+    lenv_put(e, k, v); lval_del(k); lval_del(v);
+
+    for (int i = 0; i < FORMS; i++) {
+        mpc_result_t r;
+        if (!mpc_parse("<bench>", forms[i], lispy_parser(), &r)) {
+            mpc_err_print(r.error);
+            mpc_err_delete(r.error);
+            return 1;
+        }
+        lval* x = lval_read(r.output);
+        mpc_ast_delete(r.output);
+
+        long sum = 0;
+        double plain = run(e, x, &sum);
+        int folded = 0;
+        x = lval_fold(e, x, &folded);
+        double fold = run(e, x, &sum);
+
+        printf("form %d  folded %2d  %7.1f -> %7.1f ns  (checksum %ld)\n",
+               i, folded, plain * 1e9 / ROUNDS, fold * 1e9 / ROUNDS, sum);
+        lval_del(x);
+    }
+
+    lenv_del(e);
+    lvm_cleanup();
+    lispy_parser_cleanup();
+    intern_cleanup();
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include "../src/lispy.h"
+#include "../src/gc.h"
+
+/*
+  Reference counting against the tracing collector. This file is
+  built twice, as gc_compare and as gc_compare_gc with -DLISPY_GC,
+  and both run the same scripts the way the REPL does. Each script
+  is read once and its forms evaluated in turn, ROUNDS times over.
+
+  'closures' makes a call scope per form that closures hold on to.
+  Counting frees those bound in their own scope, but 'ring' keeps its
+  scope through a list, a cycle only the collector reclaims.
+*/
+
+enum { ROUNDS = 20000 };
+
+static const char* arith =
+    "(def {x y} 6 7)"
+    "(+ (* 2 3) (- 10 4) (/ 20 5) (* (+ 1 2) (- 7 3))"
+    "   (% 17 5) (^ 2 10) (- (* x y) (+ x y)) (/ (* x 100) (+ y 1)))";
+
+static const char* lists =
+    "(def {big} (tail (tail (join {1 2 3 4 5 6 7 8 9 10} {11 12 13 14 15}"
+    "  {16 17 18 19 20} {21 22 23 24 25 26 27 28 29 30}))))"
+    "(def {big} (join big big big big))"
+    "(len (join big big (tail big) (list big big)))"
+    "(head (tail (tail big)))"
+    "(def {pairs} (list (head big) (tail big) {x y z} (eval {list 1 2 3})))";
+
+static const char* closures =
+    "(def {seq} (\\ {_ x} {x}))"
+    "(def {adder} (\\ {n} {\\ {x} {+ x n}}))"
+    "(def {fs} (list (adder 1) (adder 2) (adder 3)))"
+    "((eval (head fs)) 10)"
+    "(def {self} (\\ {n} {seq (= {me} (\\ {x} {me})) n}))"
+    "(self 4)"
+    "(def {ring} (\\ {n} {seq (= {fs} (list (\\ {x} {fs}))) n}))"
+    "(ring 5)";
+
+static void run(const char* name, const char* src) {
+    mpc_result_t r;
+    if (!mpc_parse("<bench>", src, lispy_parser(), &r)) {
+        mpc_err_print(r.error);
+        mpc_err_delete(r.error);
+        return;
+    }
+    lval* forms = lval_read(r.output);
+    mpc_ast_delete(r.output);
+    gc_push(forms);
+
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    long sum = 0;
+    double start = bench_now();
+    for (int i = 0; i < ROUNDS; i++) {
+        for (int j = 0; j < forms->count; j++) {
+            lval* x = lval_eval(e, lval_ref(forms->cell[j]));
+            if (lval_type(x) == LVAL_NUM) { sum += lval_long(x); }
+            lval_del(x);
+        }
+    }
+    double elapsed = bench_now() - start;
+
+    printf("%-8s %8.2f us/round  peak %6ld KB  %4ld collections"
+           "  (checksum %ld)\n", name, elapsed * 1e6 / ROUNDS,
+           bench_peak_kb(), gc_collections(), sum);
+
+    lenv_del(e);
+    gc_unwind(0);
+    lval_del(forms);
+    gc_collect();
+}
+
+int main(void) {
+#ifdef LISPY_GC
+    puts("mark-and-sweep");
+#else
+    puts("reference counting");
+#endif
+    run("arith", arith);
+    run("lists", lists);
+    run("closures", closures);
+
+    lispy_parser_cleanup();
+    intern_cleanup();
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/lispy.h"
+
+/*
+  Symbol lookup cost as the environment grows. Each size binds N
+  fresh symbols and then performs the same number of lookups spread
+  over all of them, so a flat ns/lookup column means lookups do not
+  depend on how many bindings exist.
+*/
+
+enum { LOOKUPS = 2000000 };
+
+static void run(int n) {
+    char name[32];
+    lenv* e = lenv_new();
+    lval** keys = malloc(sizeof(lval*) * n);
+
+    for (int i = 0; i < n; i++) {
+        snprintf(name, sizeof(name), "sym%d", i);
+        keys[i] = lval_sym(name);
+        lval* v = lval_num(i);
+        lenv_put(e, keys[i], v);
+        lval_del(v);
+    }
+
+    double start = bench_now();
+    long sum = 0;
+    for (long i = 0; i < LOOKUPS; i++) {
+        lval* x = lenv_get(e, keys[(i * 7919) % n]);
+        sum += lval_long(x);
+        lval_del(x);
+    }
+    double elapsed = bench_now() - start;
+
+    printf("%8d bindings  %7.1f ns/lookup  (checksum %ld)\n",
+           n, elapsed * 1e9 / LOOKUPS, sum);
+
+    for (int i = 0; i < n; i++) { lval_del(keys[i]); }
+    free(keys);
+    lenv_del(e);
+}
+
+int main(void) {
+    int sizes[] = { 10, 100, 1000, 10000, 100000 };
+    for (int i = 0; i < 5; i++) { run(sizes[i]); }
+    intern_cleanup();
+    return 0;
+}
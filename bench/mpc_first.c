@@ -0,0 +1,107 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/lispy.h"
+
+/*
+  First character dispatch in mpc 'or', in MB of source per second.
+  The same forms are parsed with lispy's own grammar, whose 'expr' has
+  four alternatives, and with a wider one of nine, where most of them
+  cannot start with what comes next. mpc_first_ordered is the same
+  built with -DMPC_NO_DISPATCH, trying every alternative in order.
+*/
+
+enum { SOURCE_KB = 4 * 1024, RUNS = 3 };
+
+static const char* forms[] = {
+    "(def {fact} (\\ {n acc} {if (<= n 1) {acc} {fact (- n 1) (* n acc)}}))\n",
+    "(+ (* 2 3) (- 10 4) (/ 20 5) (* (+ 1 2) (- 7 3)) (% 17 5) (^ 2 10))\n",
+    "(len (join (tail {1 2 3 4 5 6 7 8}) (head {9 10 11}) (list x y)))\n",
+    "(def {pairs} (list (head big) (tail big) {x y z} (eval {list 1 2 3})))\n",
+    "  (if (== (len xs) 0) {nil} {join (head xs) (rest (tail xs))})\n",
+};
+
+enum { FORMS = sizeof forms / sizeof forms[0] };
+
+static const char* wide =
+    "number  : /-?[0-9]+/ ;                                  "
+    "symbol  : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&%\\^]+/ ;           "
+    "string  : /\"(\\\\.|[^\"])*\"/ ;                          "
+    "char    : /#\\\\[a-z]+/ ;                                "
+    "comment : /;[^\\r\\n]*/ ;                                "
+    "quote   : '\\'' <expr> ;                                 "
+    "vector  : '[' <expr>* ']' ;                             "
+    "sexpr   : '(' <expr>* ')' ;                             "
+    "qexpr   : '{' <expr>* '}' ;                             "
+    "expr    : <string> | <char> | <comment> | <quote> | <vector>"
+    "        | <number> | <symbol> | <sexpr> | <qexpr> ;     "
+    "lispy   : /^/ <expr>* /$/ ;                             ";
+
+enum { WIDE_RULES = 11 };
+
+static char* make_source(size_t kb) {
+    char* s = malloc(kb * 1024 + 128);
+    size_t n = 0;
+    for (size_t i = 0; n < kb * 1024; i++) {
+        size_t l = strlen(forms[i % FORMS]);
+        memcpy(s + n, forms[i % FORMS], l);
+        n += l;
+    }
+    s[n] = '\0';
+    return s;
+}
+
+/* Best of RUNS, in MB/s */
+static double run(mpc_parser_t* p, const char* s) {
+    double best = 0;
+    for (int i = 0; i < RUNS; i++) {
+        mpc_result_t r;
+        double start = bench_now();
+        if (!mpc_parse("<bench>", s, p, &r)) {
+            mpc_err_print(r.error);
+            exit(1);
+        }
+        double t = bench_now() - start;
+        mpc_ast_delete(r.output);
+        if (i == 0 || t < best) { best = t; }
+    }
+    return strlen(s) / (1024.0 * 1024.0) / best;
+}
+
+int main(void) {
+#ifdef MPC_NO_DISPATCH
+    const char* how = "ordered";
+#else
+    const char* how = "dispatch";
+#endif
+    mpc_ast_arena_set(1);
+    char* s = make_source(SOURCE_KB);
+
+    printf("%-8s lispy grammar  %7.2f MB/s\n", how, run(lispy_parser(), s));
+
+    const char* names[WIDE_RULES] = {
+        "number", "symbol", "string", "char", "comment", "quote",
+        "vector", "sexpr", "qexpr", "expr", "lispy",
+    };
+    mpc_parser_t* rules[WIDE_RULES];
+    for (int i = 0; i < WIDE_RULES; i++) { rules[i] = mpc_new(names[i]); }
+    mpc_err_t* err = mpca_lang(MPCA_LANG_DEFAULT, wide,
+        rules[0], rules[1], rules[2], rules[3], rules[4], rules[5],
+        rules[6], rules[7], rules[8], rules[9], rules[10], NULL);
+    if (err) {
+        mpc_err_print(err);
+        return 1;
+    }
+
+    printf("%-8s wide grammar   %7.2f MB/s\n", how, run(rules[10], s));
+
+    mpc_cleanup(WIDE_RULES,
+        rules[0], rules[1], rules[2], rules[3], rules[4], rules[5],
+        rules[6], rules[7], rules[8], rules[9], rules[10]);
+    free(s);
+    lispy_parser_cleanup();
+    intern_cleanup();
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/lispy.h"
+
+/*
+  mpc input throughput, in MB of source per second, parsing the same
+  file through each kind of mpc input: mpc_parse_file reading it with
+  stdio, mpc_parse_pipe reading it from cat, mpc_parse_contents
+  mapping it and mpc_parse reading it from memory. Every AST is checked
+  against the first, so the inputs must agree on what they read.
+*/
+
+enum { SOURCE_KB = 4 * 1024 };
+
+static const char* forms[] = {
+    "(def {fact} (\\ {n acc} {if (<= n 1) {acc} {fact (- n 1) (* n acc)}}))\n",
+    "(+ (* 2 3) (- 10 4) (/ 20 5) (* (+ 1 2) (- 7 3)) (% 17 5) (^ 2 10))\n",
+    "(len (join (tail {1 2 3 4 5 6 7 8}) (head {9 10 11}) (list x y)))\n",
+    "(def {pairs} (list (head big) (tail big) {x y z} (eval {list 1 2 3})))\n",
+    "  (if (== (len xs) 0) {nil} {join (head xs) (rest (tail xs))})\n",
+};
+
+enum { FORMS = sizeof forms / sizeof forms[0] };
+
+static char path[32];
+
+/* Write about 'kb' of source to a new 'path'; returns its size in bytes */
+static size_t make_source(size_t kb) {
+    strcpy(path, "/tmp/lispy_bench_XXXXXX");
+    int fd = mkstemp(path);
+    FILE* f = fdopen(fd, "w");
+    size_t n = 0;
+    for (size_t i = 0; n < kb * 1024; i++) {
+        fputs(forms[i % FORMS], f);
+        n += strlen(forms[i % FORMS]);
+    }
+    fclose(f);
+    return n;
+}
+
+static mpc_ast_t* expect = NULL;
+
+static void check(int ok, mpc_result_t* r, const char* how) {
+    if (!ok) {
+        mpc_err_print(r->error);
+        exit(1);
+    }
+    if (expect == NULL) {
+        expect = r->output;
+        return;
+    }
+    if (!mpc_ast_eq(expect, r->output)) {
+        printf("%s read a different AST\n", how);
+        exit(1);
+    }
+    mpc_ast_delete(r->output);
+}
+
+static double parse_file(void) {
+    mpc_result_t r;
+    FILE* f = fopen(path, "rb");
+    double start = bench_now();
+    int ok = mpc_parse_file(path, f, lispy_parser(), &r);
+    double t = bench_now() - start;
+    fclose(f);
+    check(ok, &r, "mpc_parse_file");
+    return t;
+}
+
+static double parse_pipe(void) {
+    char cmd[64];
+    snprintf(cmd, sizeof cmd, "cat %s", path);
+    mpc_result_t r;
+    FILE* f = popen(cmd, "r");
+    double start = bench_now();
+    int ok = mpc_parse_pipe(path, f, lispy_parser(), &r);
+    double t = bench_now() - start;
+    pclose(f);
+    check(ok, &r, "mpc_parse_pipe");
+    return t;
+}
+
+static double parse_contents(void) {
+    mpc_result_t r;
+    double start = bench_now();
+    int ok = mpc_parse_contents(path, lispy_parser(), &r);
+    double t = bench_now() - start;
+    check(ok, &r, "mpc_parse_contents");
+    return t;
+}
+
+static double parse_string(const char* s) {
+    mpc_result_t r;
+    double start = bench_now();
+    int ok = mpc_parse(path, s, lispy_parser(), &r);
+    double t = bench_now() - start;
+    check(ok, &r, "mpc_parse");
+    return t;
+}
+
+int main(void) {
+    mpc_ast_arena_set(1);
+
+    size_t len = make_source(SOURCE_KB);
+    double mb = len / (1024.0 * 1024.0);
+    double file = parse_file();
+    double pipe = parse_pipe();
+    double contents = parse_contents();
+
+    FILE* f = fopen(path, "rb");
+    char* s = malloc(len + 1);
+    s[fread(s, 1, len, f)] = '\0';
+    fclose(f);
+    double string = parse_string(s);
+    free(s);
+
+    printf("%.1f MB  file %6.2f MB/s  pipe %6.2f MB/s  "
+           "contents %6.2f MB/s  string %6.2f MB/s\n",
+           mb, mb / file, mb / pipe, mb / contents, mb / string);
+    mpc_ast_delete(expect);
+    remove(path);
+
+    lispy_parser_cleanup();
+    intern_cleanup();
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/mpc.h"
+
+/*
+  Packrat memoization: a grammar whose alternatives all start with the
+  same rule, so without a memo every level of nesting parses what is
+  under it three times over. Each depth is parsed with the plain
+  grammar and with 'b' marked @memo, and the two ASTs are compared.
+*/
+
+static const char* plain =
+    "top : /^/ <a> /$/ ;"
+    "a : <b> 'x' | <b> 'y' | <b> ;"
+    "b : '(' <a> ')' | 'z' ;";
+
+static const char* memo =
+    "top : /^/ <a> /$/ ;"
+    "a : <b> 'x' | <b> 'y' | <b> ;"
+    "b @memo : '(' <a> ')' | 'z' ;";
+
+typedef struct {
+    mpc_parser_t* top;
+    mpc_parser_t* a;
+    mpc_parser_t* b;
+} grammar;
+
+static grammar grammar_new(const char* lang) {
+    grammar g = { mpc_new("top"), mpc_new("a"), mpc_new("b") };
+    mpc_err_t* err = mpca_lang(MPCA_LANG_DEFAULT, lang, g.top, g.a, g.b, NULL);
+    if (err) {
+        mpc_err_print(err);
+        exit(1);
+    }
+    return g;
+}
+
+/* 'depth' brackets around a 'z'; with no 'x' or 'y', 'a' tries all three */
+static char* make_source(int depth) {
+    char* s = malloc(2 * depth + 2);
+    memset(s, '(', depth);
+    s[depth] = 'z';
+    memset(s + depth + 1, ')', depth);
+    s[2 * depth + 1] = '\0';
+    return s;
+}
+
+static mpc_ast_t* parse(grammar* g, const char* s, double* t) {
+    mpc_result_t r;
+    double start = bench_now();
+    if (!mpc_parse("<bench>", s, g->top, &r)) {
+        mpc_err_print(r.error);
+        exit(1);
+    }
+    *t = bench_now() - start;
+    return r.output;
+}
+
+int main(void) {
+    grammar p = grammar_new(plain);
+    grammar m = grammar_new(memo);
+
+    for (int depth = 4; depth <= 12; depth += 2) {
+        char* s = make_source(depth);
+        double tp, tm;
+        mpc_ast_t* a = parse(&p, s, &tp);
+        mpc_ast_t* b = parse(&m, s, &tm);
+        if (!mpc_ast_eq(a, b)) {
+            fprintf(stderr, "depth %d: memoized AST differs\n", depth);
+            exit(1);
+        }
+        printf("depth %2d  plain %9.4f s  memo %9.4f s\n", depth, tp, tm);
+        mpc_ast_delete(a);
+        mpc_ast_delete(b);
+        free(s);
+    }
+
+    mpc_stats(m.top);
+
+    mpc_cleanup(3, p.top, p.a, p.b);
+    mpc_cleanup(3, m.top, m.a, m.b);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include "../src/mpc.h"
+
+/*
+  mpc_parse_pipe on a single form of 1, 10 and 100 MB, written into
+  the pipe by a child process as it is read. The whole form is inside
+  one mark, so every byte of it has to be kept for backtracking;
+  throughput should not depend on its size. The grammar throws its
+  results away as it goes, so only the input is being measured, not
+  building an AST for it.
+*/
+
+static const int sizes_mb[] = { 1, 10, 100 };
+
+enum { SIZES = sizeof sizes_mb / sizeof sizes_mb[0] };
+
+static const char word[] =
+    "123456789012345678901234567890123456789012345678901234567890 ";
+
+/* A fold that frees everything it is given */
+static mpc_val_t* drop(int n, mpc_val_t** xs) {
+    for (int i = 0; i < n; i++) { free(xs[i]); }
+    return NULL;
+}
+
+/* A child writing "{word word ... }" of about 'mb' MB into a pipe */
+static FILE* writer(int mb, pid_t* pid) {
+    int fds[2];
+    if (pipe(fds) != 0) { perror("pipe"); exit(1); }
+    *pid = fork();
+    if (*pid == 0) {
+        close(fds[0]);
+        FILE* out = fdopen(fds[1], "w");
+        size_t n = (size_t)mb * 1024 * 1024 / (sizeof word - 1);
+        fputc('{', out);
+        for (size_t i = 0; i < n; i++) { fputs(word, out); }
+        fputc('}', out);
+        fclose(out);
+        _exit(0);
+    }
+    close(fds[1]);
+    return fdopen(fds[0], "r");
+}
+
+int main(void) {
+    mpc_parser_t* words = mpc_many(drop,
+        mpc_and(2, drop, mpc_digits(), mpc_whitespaces(), free));
+    mpc_parser_t* form = mpc_and(3, drop,
+        mpc_char('{'), words, mpc_char('}'), free, free);
+
+    for (int i = 0; i < SIZES; i++) {
+        pid_t pid;
+        FILE* in = writer(sizes_mb[i], &pid);
+
+        mpc_result_t r;
+        double start = bench_now();
+        int ok = mpc_parse_pipe("<pipe>", in, form, &r);
+        double t = bench_now() - start;
+        fclose(in);
+        waitpid(pid, NULL, 0);
+
+        if (!ok) {
+            mpc_err_print(r.error);
+            mpc_err_delete(r.error);
+            return 1;
+        }
+        printf("%4d MB form  %6.2f s  %6.2f MB/s  peak rss %ld KB\n",
+               sizes_mb[i], t, sizes_mb[i] / t, bench_peak_kb());
+    }
+
+    mpc_delete(form);
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/mpc.h"
+
+/*
+  Regex matching, in MB of source per second. The same tokens are
+  read with parsers from mpc_re, which are compiled into tables, and
+  with the combinators mpc_re would have built for them, which is how
+  every regex was matched before. Both must find the same tokens.
+
+  Each is timed twice: as is, where the error for what else could
+  have come next is kept up to date after every token, and inside an
+  mpc_expect, where errors are not kept and only matching is left.
+*/
+
+enum { SOURCE_KB = 4 * 1024, RUNS = 3 };
+
+static const char* words[] = {
+    "def", "fact", "-12", "acc", "<=", "345", "if", "list", "x_1",
+    "join", "head", "tail", "\n", "*", "100000", "eval", "-", "len",
+};
+
+enum { WORDS = sizeof words / sizeof words[0] };
+
+/* Tokens separated by spaces, about 'kb' of them */
+static char* make_source(size_t kb) {
+    char* s = malloc(kb * 1024 + 16);
+    size_t n = 0;
+    for (size_t i = 0; n < kb * 1024; i++) {
+        size_t l = strlen(words[i % WORDS]);
+        memcpy(s + n, words[i % WORDS], l);
+        s[n + l] = ' ';
+        n += l + 1;
+    }
+    s[n] = '\0';
+    return s;
+}
+
+/* Count the tokens; each is freed as it is read, rather than kept */
+static mpc_val_t* count_fold(int n, mpc_val_t** xs) {
+    (void)xs;
+    long* c = malloc(sizeof(long));
+    *c = n;
+    return c;
+}
+
+static mpc_parser_t* tokens(int quiet, mpc_parser_t* number, mpc_parser_t* symbol, mpc_parser_t* space) {
+    mpc_parser_t* token = mpc_or(3, number, symbol, space);
+    if (quiet) { token = mpc_expect(token, "token"); }
+    return mpc_many(count_fold, mpc_apply(token, mpcf_free));
+}
+
+static mpc_parser_t* regex_tokens(int quiet) {
+    return tokens(quiet,
+        mpc_re("-?[0-9]+"),
+        mpc_re("[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+"),
+        mpc_re("[ \\t\\n]+"));
+}
+
+static mpc_parser_t* combinator_tokens(int quiet) {
+    return tokens(quiet,
+        mpc_and(2, mpcf_strfold,
+            mpc_maybe_lift(mpc_char('-'), mpcf_ctor_str),
+            mpc_many1(mpcf_strfold, mpc_oneof("0123456789")), free),
+        mpc_many1(mpcf_strfold, mpc_oneof("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_+-*/\\=<>!&")),
+        mpc_many1(mpcf_strfold, mpc_oneof(" \t\n")));
+}
+
+/* Best of RUNS; sets 'count' to the tokens read */
+static double run(mpc_parser_t* p, const char* s, long* count) {
+    double best = 0;
+    for (int i = 0; i < RUNS; i++) {
+        mpc_result_t r;
+        double start = bench_now();
+        if (!mpc_parse("<bench>", s, p, &r)) {
+            mpc_err_print(r.error);
+            exit(1);
+        }
+        double t = bench_now() - start;
+        *count = *(long*)r.output;
+        free(r.output);
+        if (i == 0 || t < best) { best = t; }
+    }
+    return best;
+}
+
+int main(void) {
+    char* s = make_source(SOURCE_KB);
+    double mb = strlen(s) / (1024.0 * 1024.0);
+
+    printf("%.1f MB\n", mb);
+    for (int quiet = 0; quiet <= 1; quiet++) {
+        mpc_parser_t* re = regex_tokens(quiet);
+        mpc_parser_t* comb = combinator_tokens(quiet);
+
+        long nr, nc;
+        double tr = run(re, s, &nr);
+        double tc = run(comb, s, &nc);
+        if (nr != nc) {
+            fprintf(stderr, "regex read %ld tokens, combinators %ld\n", nr, nc);
+            return 1;
+        }
+
+        printf("%-10s %ld tokens  combinators %7.2f MB/s  regex table %7.2f MB/s\n",
+               quiet ? "no errors" : "errors", nr, mb / tc, mb / tr);
+
+        mpc_delete(re);
+        mpc_delete(comb);
+    }
+    free(s);
+    return 0;
+}
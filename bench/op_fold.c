@@ -0,0 +1,50 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include "../src/lispy.h"
+
+/*
+  Cost per argument of an arithmetic call such as (+ 1 2 ... 100000).
+  Each evaluation copies the shared argument list before folding it,
+  so the figure includes that copy. The 'boxed' rows end the list with
+  a number outside the fixnum range, which takes the generic path.
+*/
+
+enum { ARGS = 100000, ROUNDS = 200 };
+
+static void run(lenv* e, const char* op, int boxed) {
+    lval* s = lval_add(lval_sexpr(), lval_sym(op));
+    for (long i = 1; i < ARGS; i++) {
+        s = lval_add(s, lval_num(i % 7 + 1));
+    }
+    s = lval_add(s, lval_num(boxed ? LVAL_FIX_MAX + 1 : 1));
+
+    double start = bench_now();
+    long sum = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        lval* x = lval_eval(e, lval_ref(s));
+        sum += lval_long(x);
+        lval_del(x);
+    }
+    double elapsed = bench_now() - start;
+
+    printf("(%s ...) %-6s %6.2f ns/arg  (checksum %ld)\n", op,
+           boxed ? "boxed" : "fixnum",
+           elapsed * 1e9 / ((double)ROUNDS * ARGS), sum);
+    lval_del(s);
+}
+
+int main(void) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    const char* ops[] = { "+", "-", "*", "/" };
+    for (int i = 0; i < 4; i++) {
+        run(e, ops[i], 0);
+        run(e, ops[i], 1);
+    }
+
+    lenv_del(e);
+    intern_cleanup();
+    return 0;
+}
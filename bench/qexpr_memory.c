@@ -0,0 +1,107 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/lispy.h"
+
+/*
+  Resident memory of a 1M-element numeric Q-Expression, and the time
+  to walk it. Resident size is sampled before and after building it.
+
+  The same list is then built the way it was before the tagged union,
+  for comparison: every member side by side in one struct, each number
+  malloc'd on its own and the cell array grown by realloc on each add.
+*/
+
+enum { ELEMS = 1000000 };
+
+/* struct lval before the tagged union and fixnums */
+typedef struct lval_flat {
+    int type;
+    int refs;
+    long num;
+    char* err;
+    lsym sym;
+    lbuiltin fun;
+    int count;
+    struct lval_flat** cell;
+} lval_flat;
+
+static void report(const char* name, size_t node, long rss,
+                   double built, double walked, long sum) {
+    printf("%-8s %2zu-byte nodes  %6ld KB resident (%4.1f bytes/element)  "
+           "build %5.1f ms, walk %.2f ms  (checksum %ld)\n",
+           name, node, rss, rss * 1024.0 / ELEMS,
+           built * 1e3, walked * 1e3, sum);
+}
+
+static void run_current(void) {
+    long base = bench_rss_kb();
+
+    double start = bench_now();
+    lval* q = lval_qexpr();
+    for (long i = 0; i < ELEMS; i++) {
+        q = lval_add(q, lval_num(i));
+    }
+    double built = bench_now() - start;
+
+    long rss = bench_rss_kb() - base;
+
+    start = bench_now();
+    long sum = 0;
+    for (int r = 0; r < 10; r++) {
+        for (int i = 0; i < q->count; i++) {
+            sum += lval_long(q->cell[i]);
+        }
+    }
+    double walked = (bench_now() - start) / 10;
+
+    report("current", sizeof(lval), rss, built, walked, sum);
+    lval_del(q);
+}
+
+static lval_flat* flat_new(int type) {
+    lval_flat* v = malloc(sizeof(lval_flat));
+    v->type = type;
+    v->refs = 1;
+    return v;
+}
+
+static void run_baseline(void) {
+    long base = bench_rss_kb();
+
+    double start = bench_now();
+    lval_flat* q = flat_new(LVAL_QEXPR);
+    q->count = 0;
+    q->cell = NULL;
+    for (long i = 0; i < ELEMS; i++) {
+        lval_flat* x = flat_new(LVAL_NUM);
+        x->num = i;
+        q->count++;
+        q->cell = realloc(q->cell, sizeof(lval_flat*) * q->count);
+        q->cell[q->count - 1] = x;
+    }
+    double built = bench_now() - start;
+
+    long rss = bench_rss_kb() - base;
+
+    start = bench_now();
+    long sum = 0;
+    for (int r = 0; r < 10; r++) {
+        for (int i = 0; i < q->count; i++) {
+            sum += q->cell[i]->num;
+        }
+    }
+    double walked = (bench_now() - start) / 10;
+
+    report("baseline", sizeof(lval_flat), rss, built, walked, sum);
+    for (int i = 0; i < q->count; i++) { free(q->cell[i]); }
+    free(q->cell);
+    free(q);
+}
+
+int main(void) {
+    run_current();
+    run_baseline();
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/lispy.h"
+#include "../src/reader.h"
+
+/*
+  Reader throughput, in MB of source per second: the built-in reader
+  against mpc_parse followed by lval_read on its AST. The source is
+  typical forms, one per line, read two ways: line by line as the
+  REPL does, and as one input. mpc slows down faster than linearly
+  on a single large input, so that source is kept small. Last, the
+  AST-to-lval step of the mpc path on its own.
+*/
+
+enum { LINES_KB = 1024, WHOLE_KB = 32, CONVERT_ROUNDS = 100 };
+
+static const char* forms[] = {
+    "(def {fact} (\\ {n acc} {if (<= n 1) {acc} {fact (- n 1) (* n acc)}}))\n",
+    "(+ (* 2 3) (- 10 4) (/ 20 5) (* (+ 1 2) (- 7 3)) (% 17 5) (^ 2 10))\n",
+    "(len (join (tail {1 2 3 4 5 6 7 8}) (head {9 10 11}) (list x y)))\n",
+    "(def {pairs} (list (head big) (tail big) {x y z} (eval {list 1 2 3})))\n",
+    "  (if (== (len xs) 0) {nil} {join (head xs) (rest (tail xs))})\n",
+};
+
+enum { FORMS = sizeof forms / sizeof forms[0] };
+
+static char* make_source(size_t kb, size_t* len) {
+    size_t cap = kb * 1024;
+    char* s = malloc(cap + 256);
+    size_t n = 0;
+    for (int i = 0; n < cap; i++) {
+        const char* f = forms[i % FORMS];
+        size_t k = strlen(f);
+        memcpy(s + n, f, k);
+        n += k;
+    }
+    s[n] = '\0';
+    *len = n;
+    return s;
+}
+
+static long read_builtin(const char* s, size_t len) {
+    lval* x = lval_read_str("<bench>", s, len);
+    long n = x->count;
+    lval_del(x);
+    return n;
+}
+
+static long read_mpc(const char* s) {
+    mpc_result_t r;
+    if (!mpc_parse("<bench>", s, lispy_parser(), &r)) {
+        mpc_err_print(r.error);
+        mpc_err_delete(r.error);
+        exit(1);
+    }
+    lval* x = lval_read(r.output);
+    mpc_ast_delete(r.output);
+    long n = x->count;
+    lval_del(x);
+    return n;
+}
+
+/* Read 's' a line at a time, each line as its own input */
+static double lines(char* s, size_t len, int mpc, long* count) {
+    double start = bench_now();
+    for (char* p = s; p < s + len;) {
+        char* nl = memchr(p, '\n', s + len - p);
+        *nl = '\0';
+        *count += mpc ? read_mpc(p) : read_builtin(p, nl - p);
+        *nl = '\n';
+        p = nl + 1;
+    }
+    return bench_now() - start;
+}
+
+static double whole(char* s, size_t len, int mpc, long* count) {
+    double start = bench_now();
+    *count += mpc ? read_mpc(s) : read_builtin(s, len);
+    return bench_now() - start;
+}
+
+int main(void) {
+    long count = 0;
+    size_t len;
+
+    char* src = make_source(LINES_KB, &len);
+    double mb = len / (1024.0 * 1024.0);
+    double reader = lines(src, len, 0, &count);
+    double mpc = lines(src, len, 1, &count);
+    printf("lines  %5zu KB  reader %7.1f MB/s  mpc %6.2f MB/s\n",
+           len / 1024, mb / reader, mb / mpc);
+    free(src);
+
+    src = make_source(WHOLE_KB, &len);
+    mb = len / (1024.0 * 1024.0);
+    reader = whole(src, len, 0, &count);
+    mpc = whole(src, len, 1, &count);
+    printf("whole  %5zu KB  reader %7.1f MB/s  mpc %6.2f MB/s"
+           "  (forms read %ld)\n", len / 1024, mb / reader, mb / mpc, count);
+
+    /* The same AST converted over and over */
+    mpc_result_t r;
+    mpc_parse("<bench>", src, lispy_parser(), &r);
+    double start = bench_now();
+    for (int i = 0; i < CONVERT_ROUNDS; i++) {
+        lval* x = lval_read(r.output);
+        count += x->count;
+        lval_del(x);
+    }
+    double convert = bench_now() - start;
+    mpc_ast_delete(r.output);
+    printf("lval_read      %7.1f MB/s of source\n", mb * CONVERT_ROUNDS / convert);
+    free(src);
+
+    lispy_parser_cleanup();
+    intern_cleanup();
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include "../src/lispy.h"
+#include "../src/vm.h"
+#include "../src/gc.h"
+
+/*
+  A tail-recursive countdown, run for growing iteration counts. Tail
+  calls loop inside lval_eval, so neither the C stack nor the heap
+  should grow with the count: the time per iteration and the resident
+  size should stay flat all the way to ten million.
+*/
+
+static const char* src =
+    "(def {loop} (\\ {n} {if (== n 0) {0} {loop (- n 1)}}))";
+
+static lval* read_forms(const char* s) {
+    mpc_result_t r;
+    if (!mpc_parse("<bench>", s, lispy_parser(), &r)) {
+        mpc_err_print(r.error);
+        mpc_err_delete(r.error);
+        return NULL;
+    }
+    lval* forms = lval_read(r.output);
+    mpc_ast_delete(r.output);
+    return forms;
+}
+
+
+
+int main(void) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval* def = read_forms(src);
+    lval_del(lvm_eval(e, def));
+
+    printf("%10s %10s %10s\n", "iterations", "ns/iter", "rss KB");
+
+    char call[64];
+    for (long n = 1000; n <= 10000000; n *= 10) {
+        snprintf(call, sizeof call, "(loop %ld)", n);
+        lval* forms = read_forms(call);
+
+        double start = bench_now();
+        lval* x = lvm_eval(e, forms);
+        double elapsed = bench_now() - start;
+
+        printf("%10ld %10.1f %10ld\n", n, elapsed * 1e9 / n, bench_rss_kb());
+        lval_del(x);
+    }
+
+    lenv_clear(e);
+    lenv_del(e);
+    gc_collect();
+    lvm_cleanup();
+    lispy_parser_cleanup();
+    intern_cleanup();
+    return 0;
+}
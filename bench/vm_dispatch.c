@@ -0,0 +1,119 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include "../src/lispy.h"
+#include "../src/vm.h"
+
+/*
+  VM dispatch on a mixed workload of list and arithmetic forms. This
+  file is built twice, as vm_dispatch with the threaded dispatch and
+  as vm_dispatch_switch with -DLISPY_NO_THREADED. Each form is
+  compiled once and run ROUNDS times; chunks have no jumps, so each
+  run executes every instruction exactly once.
+
+  Per round it reports the best wall time and time stamp counter
+  cycles of RUNS runs, and the fewest machine instructions and
+  mispredicted branches where the kernel allows counting them.
+*/
+
+enum { ROUNDS = 200000, RUNS = 5 };
+
+static const char* forms[] = {
+    "(+ (* 2 3) (- 10 4) (/ 20 5) (* (+ 1 2) (- 7 3)) (% 17 5) (^ 2 10))",
+    "(len (join (tail {1 2 3 4 5 6 7 8}) (head {9 10 11}) (list x y)))",
+    "(- (* x y) (+ x (len (list 1 2 3 x y))) (head {1 2}))",
+    "(if (> x y) {len {1 2 3}} {* (+ x 1) (len (tail {1 2 3 4}))})",
+    "(len (join (list (+ x y) (* x y)) (tail (list 1 2 3)) {4 5}))",
+};
+
+enum { FORMS = sizeof forms / sizeof forms[0] };
+
+static lenv* e;
+static lchunk* chunks[FORMS];
+static long sum = 0;
+
+/* Interleave the forms, as a script would */
+static void run(long rounds) {
+    for (long i = 0; i < rounds; i++) {
+        for (int j = 0; j < FORMS; j++) {
+            lval* x = lvm_run(e, chunks[j]);
+            if (lval_type(x) == LVAL_NUM) { sum += lval_long(x); }
+            lval_del(x);
+        }
+    }
+}
+
+int main(void) {
+    e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* k = lval_sym("x"); lval* v = lval_num(6);
+    lenv_put(e, k, v); lval_del(k); lval_del(v);
+    k = lval_sym("y"); v = lval_num(7);
+    lenv_put(e, k, v); lval_del(k); lval_del(v);
+
+    long ins = 0;
+    for (int i = 0; i < FORMS; i++) {
+        mpc_result_t r;
+        if (!mpc_parse("<bench>", forms[i], lispy_parser(), &r)) {
+            mpc_err_print(r.error);
+            mpc_err_delete(r.error);
+            return 1;
+        }
+        lval* x = lval_read(r.output);
+        mpc_ast_delete(r.output);
+        chunks[i] = lval_compile(x);
+        ins += chunks[i]->count;
+        lval_del(x);
+    }
+
+    int fd = bench_branch_misses();
+    int ifd = bench_instructions();
+    double best = 0;
+    long long best_tsc = 0, misses = -1, machine = -1;
+    for (int i = 0; i < RUNS; i++) {
+        bench_counter_start(fd);
+        bench_counter_start(ifd);
+        long long tsc = bench_tsc();
+        double start = bench_now();
+        run(ROUNDS);
+        double elapsed = bench_now() - start;
+        tsc = bench_tsc() - tsc;
+        long long n = bench_counter_read(ifd);
+        long long m = bench_counter_read(fd);
+        if (i == 0 || elapsed < best) { best = elapsed; }
+        if (i == 0 || tsc < best_tsc) { best_tsc = tsc; }
+        if (i == 0 || m < misses) { misses = m; }
+        if (i == 0 || n < machine) { machine = n; }
+    }
+
+    printf("%-8s %7.1f ns/round  %5.2f ns/instruction  %6.0f tsc cycles/round  ",
+#ifdef LISPY_NO_THREADED
+           "switch",
+#else
+           "threaded",
+#endif
+           best * 1e9 / ROUNDS, best * 1e9 / ROUNDS / ins,
+           (double)best_tsc / ROUNDS);
+    if (machine >= 0) {
+        printf("%6.0f machine instructions/round  ",
+               (double)machine / ROUNDS);
+    } else {
+        printf("machine instructions n/a  ");
+    }
+    if (misses >= 0) {
+        printf("%6.2f branch misses/round", (double)misses / ROUNDS);
+    } else {
+        printf("branch misses n/a");
+    }
+    printf("  (checksum %ld)\n", sum);
+
+    for (int i = 0; i < FORMS; i++) { lchunk_del(chunks[i]); }
+    if (fd >= 0) { close(fd); }
+    if (ifd >= 0) { close(ifd); }
+    lenv_del(e);
+    lvm_cleanup();
+    lispy_parser_cleanup();
+    intern_cleanup();
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include "../src/lispy.h"
+#include "../src/vm.h"
+
+/*
+  Tree-walker against bytecode VM on the same scripts. Each script is
+  read once and then evaluated repeatedly: by lval_eval, by running
+  a chunk compiled once, and by compiling and running every time as
+  the REPL does with --vm.
+*/
+
+enum { ROUNDS = 200000 };
+
+static const char* arith =
+    "(+ (* 2 3) (- 10 4) (/ 20 5) (* (+ 1 2) (- 7 3))"
+    "   (% 17 5) (^ 2 10) (- (* x y) (+ x y)) (/ (* x 100) (+ y 1)))";
+
+static const char* lists =
+    "(len (join (tail {1 2 3 4 5 6 7 8}) (head {9 10 11})"
+    "           (list x y (+ x y)) (eval {list 1 2 3})))";
+
+static void run(lenv* e, const char* name, const char* src) {
+    mpc_result_t r;
+    if (!mpc_parse("<bench>", src, lispy_parser(), &r)) {
+        mpc_err_print(r.error);
+        mpc_err_delete(r.error);
+        return;
+    }
+    lval* v = lval_read(r.output);
+    mpc_ast_delete(r.output);
+
+    long sum = 0;
+    double start = bench_now();
+    for (int i = 0; i < ROUNDS; i++) {
+        lval* x = lval_eval(e, lval_ref(v));
+        sum += lval_long(x);
+        lval_del(x);
+    }
+    double tree = bench_now() - start;
+
+    lchunk* c = lval_compile(v);
+    start = bench_now();
+    for (int i = 0; i < ROUNDS; i++) {
+        lval* x = lvm_run(e, c);
+        sum += lval_long(x);
+        lval_del(x);
+    }
+    double vm = bench_now() - start;
+    lchunk_del(c);
+
+    start = bench_now();
+    for (int i = 0; i < ROUNDS; i++) {
+        lval* x = lvm_eval(e, lval_ref(v));
+        sum += lval_long(x);
+        lval_del(x);
+    }
+    double once = bench_now() - start;
+
+    printf("%-6s tree %7.1f ns  vm %7.1f ns  compile+vm %7.1f ns"
+           "  (checksum %ld)\n", name, tree * 1e9 / ROUNDS,
+           vm * 1e9 / ROUNDS, once * 1e9 / ROUNDS, sum);
+    lval_del(v);
+}
+
+int main(void) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* k = lval_sym("x"); lval* v = lval_num(6);
+    lenv_put(e, k, v); lval_del(k); lval_del(v);
+    k = lval_sym("y"); v = lval_num(7);
+    lenv_put(e, k, v); lval_del(k); lval_del(v);
+
+    run(e, "arith", arith);
+    run(e, "lists", lists);
+
+    lenv_del(e);
+    lvm_cleanup();
+    lispy_parser_cleanup();
+    intern_cleanup();
+    return 0;
+}
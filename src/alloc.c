@@ -0,0 +1,290 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+
+/*
+  Nodes and small cell arrays are carved out of large slabs and
+  recycled through free lists: nodes through one list, since a list
+  may change type between allocation and free, cell arrays by
+  power-of-two size class. Larger cell arrays use malloc directly.
+  The owner's 'cap' is always the real capacity of its array, so it
+  also tells which of the two an array came from.
+
+  Nodes have slabs of their own, so lval_alloc_each can walk them.
+  A free node is typed NODE_FREE and linked through its 'cell'.
+
+  The arena is a second, independent set of slabs and free lists.
+  Everything in it, large cell arrays included, is released in one
+  shot by lval_arena_end.
+
+  Under AddressSanitizer the unused end of each slab and everything
+  freed into the arena is poisoned until it is handed out again, so
+  a use after free inside the arena is caught as well.
+*/
+
+#ifndef LISPY_MALLOC
+
+#ifndef __has_feature
+#define __has_feature(x) 0
+#endif
+#if defined(__SANITIZE_ADDRESS__) || __has_feature(address_sanitizer)
+#include <sanitizer/asan_interface.h>
+#define LSLAB_POISON(p, n)   ASAN_POISON_MEMORY_REGION(p, n)
+#define LSLAB_UNPOISON(p, n) ASAN_UNPOISON_MEMORY_REGION(p, n)
+#else
+#define LSLAB_POISON(p, n)   ((void)(p), (void)(n))
+#define LSLAB_UNPOISON(p, n) ((void)(p), (void)(n))
+#endif
+
+static size_t allocated = 0;
+
+enum {
+    SLAB_SIZE = 65536,
+    /* Classes of 1, 2, 4 ... 256 cells */
+    CELL_CLASSES = 9,
+    CELL_MAX = 1 << (CELL_CLASSES - 1),
+    NODE_FREE = 0xff
+};
+
+typedef struct lfree {
+    struct lfree* next;
+} lfree;
+
+typedef struct lslab {
+    struct lslab* next;
+    size_t used;
+    size_t size;
+    char data[];
+} lslab;
+
+typedef struct {
+    lslab* slabs;
+    lslab* node_slabs;
+    lval* nodes;
+    lfree* cells[CELL_CLASSES];
+} lheap;
+
+static lheap heap;
+static lheap arena;
+static int arena_on = 0;
+
+static void* lheap_carve(lslab** slabs, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+
+    /* Big requests get a slab of their own behind the current one */
+    if (size > SLAB_SIZE / 4) {
+        lslab* s = malloc(sizeof(lslab) + size);
+        s->used = s->size = size;
+        if (*slabs) {
+            s->next = (*slabs)->next;
+            (*slabs)->next = s;
+        } else {
+            s->next = NULL;
+            *slabs = s;
+        }
+        return s->data;
+    }
+
+    if (*slabs == NULL || (*slabs)->size - (*slabs)->used < size) {
+        lslab* s = malloc(sizeof(lslab) + SLAB_SIZE);
+        s->next = *slabs;
+        s->used = 0;
+        s->size = SLAB_SIZE;
+        *slabs = s;
+        LSLAB_POISON(s->data, SLAB_SIZE);
+    }
+
+    void* p = (*slabs)->data + (*slabs)->used;
+    (*slabs)->used += size;
+    LSLAB_UNPOISON(p, size);
+    return p;
+}
+
+static void lslab_release(lslab* s) {
+    while (s) {
+        lslab* next = s->next;
+        free(s);
+        s = next;
+    }
+}
+
+static void lheap_release(lheap* h) {
+    lslab_release(h->slabs);
+    lslab_release(h->node_slabs);
+    memset(h, 0, sizeof(lheap));
+}
+
+lval* lval_alloc(int type) {
+    lheap* h = arena_on ? &arena : &heap;
+    lval* v = h->nodes;
+
+    if (v) {
+        LSLAB_UNPOISON(v, sizeof(lval));
+        h->nodes = (lval*)v->cell;
+    } else {
+        v = lheap_carve(&h->node_slabs, sizeof(lval));
+    }
+
+    allocated += sizeof(lval);
+    v->type = type;
+    v->flags = arena_on ? LVAL_ARENA : 0;
+    return v;
+}
+
+void lval_free(lval* v) {
+    lheap* h = v->flags & LVAL_ARENA ? &arena : &heap;
+    v->type = NODE_FREE;
+    v->cell = (lval**)h->nodes;
+    h->nodes = v;
+    if (h == &arena) { LSLAB_POISON(v, sizeof(lval)); }
+}
+
+void lval_alloc_each(void (*fn)(lval* v)) {
+    for (lslab* s = heap.node_slabs; s; s = s->next) {
+        lval* v = (lval*)s->data;
+        for (size_t n = s->used / sizeof(lval); n--; v++) {
+            if (v->type != NODE_FREE) { fn(v); }
+        }
+    }
+}
+
+size_t lval_alloc_bytes(void) {
+    return allocated;
+}
+
+/* Smallest class holding 'n' cells */
+static int cell_class(int n) {
+    int c = 0;
+    while ((1 << c) < n) { c++; }
+    return c;
+}
+
+void lval_cells_resize(lval* v, int n) {
+    lheap* h = v->flags & LVAL_ARENA ? &arena : &heap;
+
+    if (n == 0) {
+        lval_cells_free(v);
+        v->cell = NULL;
+        v->cap = 0;
+        return;
+    }
+
+    lval** cell;
+    int cap = n;
+    if (n <= CELL_MAX) {
+        int c = cell_class(n);
+        cap = 1 << c;
+        if (cap == v->cap) { return; }
+        allocated += sizeof(lval*) * cap;
+        if (h->cells[c]) {
+            cell = (lval**)h->cells[c];
+            LSLAB_UNPOISON(cell, sizeof(lval*) << c);
+            h->cells[c] = h->cells[c]->next;
+        } else {
+            cell = lheap_carve(&h->slabs, sizeof(lval*) << c);
+        }
+    } else {
+        allocated += sizeof(lval*) * n;
+        if (v->flags & LVAL_ARENA) {
+            cell = lheap_carve(&h->slabs, sizeof(lval*) * n);
+        } else if (v->cap > CELL_MAX) {
+            v->cell = realloc(v->cell, sizeof(lval*) * n);
+            v->cap = n;
+            return;
+        } else {
+            cell = malloc(sizeof(lval*) * n);
+        }
+    }
+
+    if (v->cell) {
+        memcpy(cell, v->cell, sizeof(lval*) * v->count);
+        lval_cells_free(v);
+    }
+    v->cell = cell;
+    v->cap = cap;
+}
+
+void lval_cells_free(lval* v) {
+    if (v->cell == NULL) { return; }
+
+    if (v->cap > CELL_MAX) {
+        /* Arena arrays this size wait for lval_arena_end */
+        if (v->flags & LVAL_ARENA) {
+            LSLAB_POISON(v->cell, sizeof(lval*) * v->cap);
+        } else {
+            free(v->cell);
+        }
+        return;
+    }
+
+    lheap* h = v->flags & LVAL_ARENA ? &arena : &heap;
+    int c = cell_class(v->cap);
+    lfree* f = (lfree*)v->cell;
+    f->next = h->cells[c];
+    h->cells[c] = f;
+    if (h == &arena) { LSLAB_POISON(f, sizeof(lval*) << c); }
+}
+
+int lval_arena_set(int on) {
+    int was = arena_on;
+#ifndef LISPY_GC
+    arena_on = on;
+#endif
+    return was;
+}
+
+int lval_arena_active(void) {
+    return arena_on;
+}
+
+void lval_arena_end(void) {
+    arena_on = 0;
+    lheap_release(&arena);
+}
+
+void lval_alloc_cleanup(void) {
+    lval_arena_end();
+    lheap_release(&heap);
+}
+
+#else
+
+#ifdef LISPY_GC
+#error "LISPY_GC needs the slab allocator; drop LISPY_MALLOC"
+#endif
+
+lval* lval_alloc(int type) {
+    lval* v = malloc(sizeof(lval));
+    v->type = type;
+    v->flags = 0;
+    return v;
+}
+
+void lval_free(lval* v) {
+    free(v);
+}
+
+void lval_alloc_each(void (*fn)(lval* v)) {}
+size_t lval_alloc_bytes(void) { return 0; }
+
+void lval_cells_resize(lval* v, int n) {
+    if (n == 0) {
+        free(v->cell);
+        v->cell = NULL;
+    } else {
+        v->cell = realloc(v->cell, sizeof(lval*) * n);
+    }
+    v->cap = n;
+}
+
+void lval_cells_free(lval* v) {
+    free(v->cell);
+}
+
+int lval_arena_set(int on) { return 0; }
+int lval_arena_active(void) { return 0; }
+void lval_arena_end(void) {}
+void lval_alloc_cleanup(void) {}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef alloc_h
+#define alloc_h
+
+#include <stddef.h>
+#include "lispy.h"
+
+/*
+  Storage for lval nodes and their cell arrays. Build with
+  -DLISPY_MALLOC to use plain malloc and free instead, e.g. when
+  running under a memory checker that should see every node.
+  AddressSanitizer also sees the arena's frees without it.
+*/
+
+/* A node of the given type, with 'type' and 'flags' filled in */
+lval* lval_alloc(int type);
+void lval_free(lval* v);
+
+/* Visit every allocated node outside the arena */
+void lval_alloc_each(void (*fn)(lval* v));
+
+/* Bytes of nodes and cell arrays allocated so far */
+size_t lval_alloc_bytes(void);
+
+/* Give v's cell array room for 'n' >= v->count entries; sets v->cap */
+void lval_cells_resize(lval* v, int n);
+void lval_cells_free(lval* v);
+
+/*
+  Per-evaluation arena. While it is on, new values are allocated in
+  the arena and flagged LVAL_ARENA; lval_arena_end releases all of
+  them at once. Returns the previous state. Builds with LISPY_GC
+  never turn it on.
+*/
+int lval_arena_set(int on);
+int lval_arena_active(void);
+void lval_arena_end(void);
+
+/* Release every slab; no lval may be live */
+void lval_alloc_cleanup(void);
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+
+#include "vm.h"
+
+/*
+  The compiler flattens an S-Expression into postfix order: each
+  element is pushed in turn, then OP_CALL applies them. Symbols
+  become global loads and everything else becomes a constant that
+  the chunk holds a reference to.
+
+  A first pass sizes the chunk, so its code and tables are carved
+  from a single allocation and never grown.
+*/
+
+/* Count instructions, constants and global sites; 0 if too big */
+static int compile_size(lval* v, int* code, int* consts, int* globals) {
+    (*code)++;
+    switch (lval_type(v)) {
+    case LVAL_SYM: (*globals)++; break;
+    case LVAL_SEXPR:
+        if (v->count > LVM_ARG_MAX) { return 0; }
+        for (int i = 0; i < v->count; i++) {
+            if (!compile_size(v->cell[i], code, consts, globals)) {
+                return 0;
+            }
+        }
+        break;
+    default: (*consts)++; break;
+    }
+    return *consts <= LVM_ARG_MAX && *globals <= LVM_ARG_MAX;
+}
+
+/* 'depth' follows the stack as code is emitted */
+typedef struct {
+    lchunk* c;
+    int depth;
+} lcompiler;
+
+static void emit(lcompiler* k, int op, int arg, int push) {
+    lchunk* c = k->c;
+    c->code[c->count++] = (uint32_t)arg << 8 | op;
+
+    k->depth += push;
+    if (k->depth > c->depth) { c->depth = k->depth; }
+}
+
+static void compile_expr(lcompiler* k, lval* v) {
+    lchunk* c = k->c;
+
+    switch (lval_type(v)) {
+    case LVAL_SYM:
+        c->globals[c->globals_num].sym = v->sym;
+        c->globals[c->globals_num].slot = -1;
+        emit(k, OP_GLOBAL, c->globals_num++, 1);
+        break;
+
+        /* Elements first, then apply them */
+    case LVAL_SEXPR:
+        for (int i = 0; i < v->count; i++) {
+            compile_expr(k, v->cell[i]);
+        }
+        emit(k, OP_CALL, v->count, 1 - v->count);
+        break;
+
+        /* Numbers, errors, functions and Q-Expressions are literal */
+    default:
+        c->consts[c->consts_num] = lval_ref(v);
+        emit(k, OP_CONST, c->consts_num++, 1);
+        break;
+    }
+}
+
+lchunk* lval_compile(lval* v) {
+    int code = 1, consts = 0, globals = 0;
+    if (!compile_size(v, &code, &consts, &globals)) { return NULL; }
+
+    /* Pointer-sized tables first, then the code words */
+    lchunk* c = malloc(sizeof(lchunk) + sizeof(lval*) * consts
+                       + sizeof(lvm_global) * globals
+                       + sizeof(uint32_t) * code);
+    c->consts = (lval**)(c + 1);
+    c->globals = (lvm_global*)(c->consts + consts);
+    c->code = (uint32_t*)(c->globals + globals);
+    c->count = c->consts_num = c->globals_num = c->depth = 0;
+
+    lcompiler k = { c, 0 };
+    compile_expr(&k, v);
+    emit(&k, OP_RETURN, 0, -1);
+    return c;
+}
+
+void lchunk_del(lchunk* c) {
+    for (int i = 0; i < c->consts_num; i++) { lval_del(c->consts[i]); }
+    free(c);
+}
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+
+#include "fold.h"
+
+/*
+  A call is folded when its head is a symbol bound to a pure builtin
+  and every argument is a number or a Q-Expression, whether written
+  so or folded into one. Q-Expressions are data and are never entered.
+
+  Folding looks bindings up before the input runs, so it must know
+  every binding the input can change. An input is only folded if each
+  call in it is to a pure builtin, or to 'def' or '=' with the names
+  written out in a literal Q-Expression. Anything else could run code
+  or bind names from an earlier input. Calls through the names it
+  binds are left alone, and an input calling through them is not
+  folded at all.
+*/
+
+typedef struct {
+    lenv* e;
+    lsym* bound;
+    int bound_num;
+    int bound_cap;
+    int folded;
+} lfold;
+
+static void fold_bind(lfold* f, lsym s) {
+    if (f->bound_num == f->bound_cap) {
+        f->bound_cap = f->bound_cap ? f->bound_cap * 2 : 16;
+        f->bound = realloc(f->bound, sizeof(lsym) * f->bound_cap);
+    }
+    f->bound[f->bound_num++] = s;
+}
+
+static int fold_bound(lfold* f, lval* head) {
+    for (int i = 0; i < f->bound_num; i++) {
+        if (f->bound[i] == head->sym) { return 1; }
+    }
+    return 0;
+}
+
+/* The builtin the symbol 'head' names, or NULL */
+static lbuiltin fold_lookup(lfold* f, lval* head) {
+    if (lval_type(head) != LVAL_SYM) { return NULL; }
+    lval* fn = lenv_get(f->e, head);
+    lbuiltin b = lval_type(fn) == LVAL_FUN ? fn->fun : NULL;
+    lval_del(fn);
+    return b;
+}
+
+/* Note the names bound in 'v'; 0 if some are not written out */
+static int fold_scan(lfold* f, lval* v) {
+    if (lval_type(v) != LVAL_SEXPR) { return 1; }
+    for (int i = 0; i < v->count; i++) {
+        if (!fold_scan(f, v->cell[i])) { return 0; }
+    }
+    if (v->count < 2) { return 1; }
+
+    lbuiltin b = fold_lookup(f, v->cell[0]);
+    if (b == NULL || !lbuiltin_binds(b)) { return 1; }
+    lval* names = v->cell[1];
+    if (lval_type(names) != LVAL_QEXPR) { return 0; }
+    for (int i = 0; i < names->count; i++) {
+        if (lval_type(names->cell[i]) == LVAL_SYM) {
+            fold_bind(f, names->cell[i]->sym);
+        }
+    }
+    return 1;
+}
+
+/* 1 if every call in 'v' is to a pure builtin, 'def' or '=' */
+static int fold_safe(lfold* f, lval* v) {
+    if (lval_type(v) != LVAL_SEXPR) { return 1; }
+    for (int i = 0; i < v->count; i++) {
+        if (!fold_safe(f, v->cell[i])) { return 0; }
+    }
+    /* A single value is returned, not called */
+    if (v->count < 2) { return 1; }
+
+    lbuiltin b = fold_lookup(f, v->cell[0]);
+    if (b == NULL || fold_bound(f, v->cell[0])) { return 0; }
+    return lbuiltin_pure(b) || lbuiltin_binds(b);
+}
+
+static int fold_const(lval* v) {
+    return lval_type(v) == LVAL_NUM || lval_type(v) == LVAL_QEXPR;
+}
+
+/* The builtin 'head' names, if it is pure and cannot be rebound */
+static lbuiltin fold_builtin(lfold* f, lval* head) {
+    lbuiltin b = fold_lookup(f, head);
+    if (b == NULL || !lbuiltin_pure(b) || fold_bound(f, head)) { return NULL; }
+    return b;
+}
+
+static lval* fold(lfold* f, lval* v) {
+    if (lval_type(v) != LVAL_SEXPR) { return v; }
+
+    /* Arguments first, so their folds can make this call constant */
+    v = lval_own(v);
+    int constant = 1;
+    for (int i = 0; i < v->count; i++) {
+        v->cell[i] = fold(f, v->cell[i]);
+        if (i > 0 && !fold_const(v->cell[i])) { constant = 0; }
+    }
+    if (v->count < 2 || !constant) { return v; }
+
+    lbuiltin b = fold_builtin(f, v->cell[0]);
+    if (b == NULL) { return v; }
+
+    lval* a = lval_reserve(lval_sexpr(), v->count - 1);
+    for (int i = 1; i < v->count; i++) {
+        a = lval_add(a, lval_ref(v->cell[i]));
+    }
+
+    /* Errors are left for evaluation to report */
+    lval* x = b(f->e, a);
+    if (lval_type(x) == LVAL_ERR) {
+        lval_del(x);
+        return v;
+    }
+
+    f->folded++;
+    lval_del(v);
+    return x;
+}
+
+lval* lval_fold(lenv* e, lval* v, int* folded) {
+    lfold f = { e, NULL, 0, 0, 0 };
+    if (fold_scan(&f, v) && fold_safe(&f, v)) { v = fold(&f, v); }
+    free(f.bound);
+    *folded += f.folded;
+    return v;
+}
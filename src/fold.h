@@ -0,0 +1,16 @@
+#ifndef fold_h
+#define fold_h
+
+#include "lispy.h"
+
+/*
+  Constant folding, an optional pass between lval_read and evaluation.
+  Calls to pure builtins whose arguments are all constants are
+  replaced by their result, innermost first, so partly constant
+  expressions still lose their constant parts.
+*/
+
+/* Fold 'v' against the bindings in 'e'; adds the calls folded to 'folded' */
+lval* lval_fold(lenv* e, lval* v, int* folded);
+
+#endif
@@ -0,0 +1,175 @@
+#ifdef LISPY_GC
+
+#include <stdlib.h>
+
+#include "gc.h"
+#include "alloc.h"
+#include "vm.h"
+
+/* Bytes allocated between collections never drop below this */
+enum { GC_MIN = 1 << 20 };
+
+typedef struct {
+    lval** items;
+    int num;
+    int cap;
+} gc_stack;
+
+static gc_stack shadow;
+static gc_stack work;
+
+static lenv** envs = NULL;
+static int envs_num = 0;
+static int envs_cap = 0;
+
+static size_t next_gc = GC_MIN;
+static size_t live = 0;
+static long collections = 0;
+
+static void gc_stack_push(gc_stack* s, lval* v) {
+    if (s->num == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 256;
+        s->items = realloc(s->items, sizeof(lval*) * s->cap);
+    }
+    s->items[s->num++] = v;
+}
+
+void gc_push(lval* v) {
+    gc_stack_push(&shadow, v);
+}
+
+int gc_depth(void) {
+    return shadow.num;
+}
+
+void gc_unwind(int depth) {
+    shadow.num = depth;
+}
+
+void gc_add_env(lenv* e) {
+    if (envs_num == envs_cap) {
+        envs_cap = envs_cap ? envs_cap * 2 : 16;
+        envs = realloc(envs, sizeof(lenv*) * envs_cap);
+    }
+    e->gc_slot = envs_num;
+    e->gc_mark = 0;
+    envs[envs_num++] = e;
+}
+
+/* Environments come and go with every call; remove in O(1) */
+static void gc_remove_env(lenv* e) {
+    lenv* last = envs[--envs_num];
+    envs[e->gc_slot] = last;
+    last->gc_slot = e->gc_slot;
+    if (envs_num == 0) {
+        free(envs);
+        envs = NULL;
+        envs_cap = 0;
+    }
+}
+
+/* Mark 'v' and queue it so its children are marked too */
+static void gc_mark(lval* v) {
+    if (lval_is_fix(v) || v->flags & LVAL_MARK) { return; }
+    v->flags |= LVAL_MARK;
+    gc_stack_push(&work, v);
+}
+
+/* Mark 'e' and the scopes it continues in, with their bindings */
+static void gc_mark_env(lenv* e) {
+    for (; e && !e->gc_mark; e = e->par) {
+        e->gc_mark = 1;
+        for (int i = 0; i < e->slots; i++) {
+            if (e->syms[i]) { gc_mark(e->vals[i]); }
+        }
+    }
+}
+
+static void gc_sweep(lval* v) {
+    if (v->flags & LVAL_MARK) {
+        v->flags &= ~LVAL_MARK;
+        live += sizeof(lval);
+        if (v->type == LVAL_SEXPR || v->type == LVAL_QEXPR) {
+            live += sizeof(lval*) * v->cap;
+        }
+        return;
+    }
+
+    switch (v->type) {
+    case LVAL_ERR: free(v->err); break;
+    case LVAL_SEXPR:
+    case LVAL_QEXPR: lval_cells_free(v); break;
+        /* The scope is swept on its own, by gc_sweep_envs */
+    case LVAL_LAMBDA: free(v->lambda); break;
+    }
+    lval_free(v);
+}
+
+/* Free unreachable scopes; their values are swept by gc_sweep */
+static void gc_sweep_envs(void) {
+    /* Downwards, as removing moves the last one into the gap */
+    for (int i = envs_num - 1; i >= 0; i--) {
+        lenv* e = envs[i];
+        if (e->gc_mark) {
+            e->gc_mark = 0;
+            continue;
+        }
+        gc_remove_env(e);
+        free(e->syms);
+        free(e->vals);
+        free(e);
+    }
+}
+
+void gc_collect(void) {
+    /* Mark from the roots, using 'work' instead of recursion */
+    for (int i = 0; i < envs_num; i++) {
+        if (envs[i]->refs > 0) { gc_mark_env(envs[i]); }
+    }
+    for (int i = 0; i < shadow.num; i++) { gc_mark(shadow.items[i]); }
+    lvm_roots(gc_mark);
+
+    while (work.num) {
+        lval* v = work.items[--work.num];
+        switch (v->type) {
+        case LVAL_SEXPR:
+        case LVAL_QEXPR:
+            for (int i = 0; i < v->count; i++) { gc_mark(v->cell[i]); }
+            break;
+        case LVAL_LAMBDA:
+            gc_mark(v->lambda->formals);
+            gc_mark(v->lambda->body);
+            gc_mark_env(v->lambda->env);
+            break;
+        case LVAL_TAIL:
+            gc_mark(v->tail.expr);
+            gc_mark_env(v->tail.env);
+            break;
+        }
+    }
+
+    live = 0;
+    lval_alloc_each(gc_sweep);
+    gc_sweep_envs();
+    collections++;
+
+    /* Let the heap grow to twice what survived before collecting again */
+    next_gc = lval_alloc_bytes() + (live > GC_MIN ? live : GC_MIN);
+
+    /* Nothing left to find; give back the bookkeeping */
+    if (envs_num == 0 && shadow.num == 0) {
+        free(shadow.items);
+        free(work.items);
+        shadow = work = (gc_stack){ NULL, 0, 0 };
+    }
+}
+
+void gc_poll(void) {
+    if (lval_alloc_bytes() >= next_gc) { gc_collect(); }
+}
+
+long gc_collections(void) {
+    return collections;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef gc_h
+#define gc_h
+
+#include "lispy.h"
+
+/*
+  Mark-and-sweep collection, chosen at build time with -DLISPY_GC.
+  In that mode lval_del only drops the share count used for
+  copy-on-write and never frees; unreachable values are swept by
+  gc_collect instead.
+
+  Scopes are collected too. lenv_new and lenv_ref pin a scope for C
+  code holding it, such as the global scope and the one a call is
+  being evaluated in, until lenv_del; references from closures,
+  pending tail calls and inner scopes' 'par' are traced instead, with
+  lenv_link, and a scope nothing reaches is swept like a value.
+
+  Roots are the pinned scopes, the VM stack and the chunks being run,
+  and a shadow stack of values the evaluator is working on. Collection
+  only happens at gc_poll, which the evaluators call where everything
+  live is reachable from those roots.
+
+  Without LISPY_GC all of this compiles away.
+*/
+
+#ifdef LISPY_GC
+
+/* Shadow stack: gc_depth before pushing, gc_unwind to drop back */
+void gc_push(lval* v);
+int gc_depth(void);
+void gc_unwind(int depth);
+
+void gc_add_env(lenv* e);
+
+/* A reference to 'e' from a value or an inner scope */
+#define lenv_link(e)       (e)
+
+/* Collect if enough has been allocated since the last collection */
+void gc_poll(void);
+void gc_collect(void);
+
+/* Collections run so far */
+long gc_collections(void);
+
+#else
+
+#define gc_push(v)         ((void)0)
+#define gc_depth()         0
+#define gc_unwind(d)       ((void)(d))
+#define gc_add_env(e)      ((void)0)
+#define lenv_link(e)       lenv_ref(e)
+#define gc_poll()          ((void)0)
+#define gc_collect()       ((void)0)
+#define gc_collections()   0L
+
+#endif
+
+#endif
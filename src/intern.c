@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "intern.h"
+
+/*
+  The intern table is an open-addressing hash set of names. Names
+  themselves live in large chunks that are only released by
+  intern_cleanup, so an lsym stays valid for the whole session.
+*/
+
+enum { INTERN_SLOTS_MIN = 256, INTERN_CHUNK = 16384 };
+
+typedef struct {
+    unsigned long hash;
+    char* name;
+} intern_slot;
+
+typedef struct intern_chunk {
+    struct intern_chunk* next;
+    size_t used;
+    size_t size;
+    char data[];
+} intern_chunk;
+
+static intern_slot* slots = NULL;
+static size_t slots_num = 0;
+static size_t names_num = 0;
+static intern_chunk* chunks = NULL;
+
+/* FNV-1a; cheap and good enough for short identifiers */
+static unsigned long intern_hash(const char* s, size_t len) {
+    unsigned long h = 2166136261UL;
+    while (len--) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+/* Copy the 'len' bytes of 'name' into a chunk, NUL-terminated */
+static char* intern_store(const char* name, size_t len) {
+    len++;
+
+    if (chunks == NULL || chunks->size - chunks->used < len) {
+        size_t size = len > INTERN_CHUNK ? len : INTERN_CHUNK;
+        intern_chunk* c = malloc(sizeof(intern_chunk) + size);
+        c->next = chunks;
+        c->used = 0;
+        c->size = size;
+        chunks = c;
+    }
+
+    char* s = chunks->data + chunks->used;
+    memcpy(s, name, len - 1);
+    s[len - 1] = '\0';
+    chunks->used += len;
+    return s;
+}
+
+/* 'name' need not be terminated; only its first 'len' bytes count */
+static intern_slot* intern_probe(intern_slot* tab, size_t num,
+                                 unsigned long hash,
+                                 const char* name, size_t len) {
+    size_t i = hash & (num - 1);
+    while (tab[i].name != NULL) {
+        if (tab[i].hash == hash && strncmp(tab[i].name, name, len) == 0
+            && tab[i].name[len] == '\0') {
+            break;
+        }
+        i = (i + 1) & (num - 1);
+    }
+    return &tab[i];
+}
+
+static void intern_grow(void) {
+    size_t num = slots_num ? slots_num * 2 : INTERN_SLOTS_MIN;
+    intern_slot* tab = calloc(num, sizeof(intern_slot));
+
+    for (size_t i = 0; i < slots_num; i++) {
+        if (slots[i].name == NULL) { continue; }
+        *intern_probe(tab, num, slots[i].hash, slots[i].name,
+                      strlen(slots[i].name)) = slots[i];
+    }
+
+    free(slots);
+    slots = tab;
+    slots_num = num;
+}
+
+lsym intern(const char* name) {
+    return intern_n(name, strlen(name));
+}
+
+lsym intern_n(const char* name, size_t len) {
+    /* Keep the load factor under one half */
+    if ((names_num + 1) * 2 > slots_num) { intern_grow(); }
+
+    unsigned long hash = intern_hash(name, len);
+    intern_slot* slot = intern_probe(slots, slots_num, hash, name, len);
+
+    if (slot->name == NULL) {
+        slot->hash = hash;
+        slot->name = intern_store(name, len);
+        names_num++;
+    }
+    return slot->name;
+}
+
+lsym intern_find(const char* name) {
+    if (slots_num == 0) { return NULL; }
+    size_t len = strlen(name);
+    return intern_probe(slots, slots_num, intern_hash(name, len),
+                        name, len)->name;
+}
+
+unsigned long lsym_hash(lsym s) {
+    /* Names are unique, so the address itself is the identity */
+    uint64_t x = (uint64_t)(uintptr_t)s;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (unsigned long)x;
+}
+
+void intern_cleanup(void) {
+    while (chunks) {
+        intern_chunk* next = chunks->next;
+        free(chunks);
+        chunks = next;
+    }
+    free(slots);
+    slots = NULL;
+    slots_num = 0;
+    names_num = 0;
+}
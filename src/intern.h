@@ -0,0 +1,28 @@
+#ifndef intern_h
+#define intern_h
+
+#include <stddef.h>
+
+/*
+  Interned symbol names. Every distinct name is stored exactly once,
+  so two symbols are equal iff their lsym pointers are equal, and an
+  lsym can be printed like any other C string.
+*/
+typedef const char* lsym;
+
+/* Return the unique lsym for name, adding it if not yet seen */
+lsym intern(const char* name);
+
+/* The same for the first 'len' bytes of name, which need not end in NUL */
+lsym intern_n(const char* name, size_t len);
+
+/* Return the lsym for name, or NULL if it was never interned */
+lsym intern_find(const char* name);
+
+/* Hash an interned symbol for use as a table key */
+unsigned long lsym_hash(lsym s);
+
+/* Release every interned name; all lsyms become invalid */
+void intern_cleanup(void);
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef lispy_h
+#define lispy_h
+
+#include <limits.h>
+#include <stdint.h>
+#include "mpc.h"
+#include "intern.h"
+
+/* Forward Declarations */
+
+struct lval;
+struct lenv;
+typedef struct lval lval;
+typedef struct lenv lenv;
+
+/**
+ * Lisp Value. LVAL_TAIL never reaches user code: it is how a call in
+ * tail position hands its body back to lval_eval's loop instead of
+ * evaluating it on a deeper C stack.
+ **/
+enum { LVAL_NUM, LVAL_ERR, LVAL_SYM,
+       LVAL_FUN, LVAL_SEXPR, LVAL_QEXPR,
+       LVAL_LAMBDA, LVAL_TAIL };
+
+typedef lval*(*lbuiltin)(lenv*, lval*);
+
+/* User function: formals and body, closed over its defining lenv */
+typedef struct {
+    lval* formals;
+    lval* body;
+    lenv* env;
+#ifndef LISPY_GC
+    /* Bindings of this closure in 'env' itself; while there are any
+       it does not count towards env->refs, see lenv_put */
+    int self;
+#endif
+} llambda;
+
+/* Flag bits */
+enum { LVAL_ARENA = 1, LVAL_MARK = 2 };
+
+/* Define Lisp value type; 'type' selects the live union member */
+struct lval {
+    unsigned char type;
+    /* LVAL_ARENA if allocated in the per-evaluation arena; LVAL_MARK
+       while the collector has found it reachable */
+    unsigned char flags;
+    /* Owners sharing this value; only a value with one may be mutated */
+    int refs;
+    union {
+        /* Only numbers outside the fixnum range are boxed */
+        long num;
+        /* Err types have some String data; Sym names are interned */
+        char* err;
+        lsym sym;
+        lbuiltin fun;
+        /* cnt, room and ptr to list of 'lval' */
+        struct {
+            int count;
+            int cap;
+            lval** cell;
+        };
+        llambda* lambda;
+        /* Expression still to be evaluated, and where */
+        struct {
+            lenv* env;
+            lval* expr;
+        } tail;
+    };
+};
+
+/**
+ * Fixnums: a number that fits in all but one bit of a pointer is
+ * stored in the lval pointer itself, shifted left with the low bit
+ * set. Real lvals are word aligned and so always have that bit clear.
+ * Use lval_type and lval_long instead of reading 'type' and 'num'.
+ **/
+#define LVAL_FIX_MAX (LONG_MAX >> 1)
+#define LVAL_FIX_MIN (LONG_MIN >> 1)
+
+static inline int lval_is_fix(const lval* v) {
+    return (uintptr_t)v & 1;
+}
+
+static inline int lval_type(const lval* v) {
+    return lval_is_fix(v) ? LVAL_NUM : v->type;
+}
+
+static inline long lval_long(const lval* v) {
+    return lval_is_fix(v) ? (long)((intptr_t)v >> 1) : v->num;
+}
+
+/*
+  Environment: an open-addressing hash table from interned symbol
+  to value. 'slots' is always zero or a power of two and an empty
+  slot has a NULL sym. Lookups that miss continue in 'par'.
+*/
+struct lenv {
+    int count;
+    int slots;
+    lsym* syms;
+    lval** vals;
+    /* Closures share environments, so they are counted too; with
+       LISPY_GC only holders outside the heap count, see gc.h */
+    int refs;
+    lenv* par;
+#ifdef LISPY_GC
+    int gc_slot;
+    /* Set while the collector has found it reachable */
+    int gc_mark;
+#else
+    /* Bindings here of closures over this same scope */
+    int self;
+#endif
+};
+
+/*
+  Argument view: a cursor over a list for builtins that consume their
+  arguments in order. Taking an argument moves it out of its cell and
+  leaves an inert fixnum behind, so nothing is shifted or reallocated;
+  the list itself is deleted as usual once the builtin is done.
+*/
+typedef struct {
+    lval* list;
+    int pos;
+} lval_args;
+
+/* Environment */
+lenv* lenv_new(void);
+lenv* lenv_ref(lenv* e);
+void lenv_del(lenv* e);
+void lenv_clear(lenv* e);
+int lenv_find(lenv* e, lsym s);
+lval* lenv_get(lenv* e, lval* k);
+void lenv_put(lenv* e, lval* k, lval* v);
+void lenv_add_builtins(lenv* e);
+
+/* True for builtins whose result depends on their arguments alone */
+int lbuiltin_pure(lbuiltin f);
+
+/* True for 'def' and '=', which bind the names their first argument lists */
+int lbuiltin_binds(lbuiltin f);
+
+/* Constructors */
+lval* lval_fun(lbuiltin func);
+lval* lval_num(long x);
+lval* lval_err(char* m);
+lval* lval_sym(const char* s);
+lval* lval_sym_n(const char* s, size_t len);
+lval* lval_sexpr(void);
+lval* lval_qexpr(void);
+lval* lval_lambda(lval* formals, lval* body, lenv* env);
+lval* lval_tail(lenv* e, lval* expr);
+
+/* Ownership */
+lval* lval_ref(lval* v);
+lval* lval_own(lval* v);
+
+/* List operations */
+void lval_del(lval* v);
+lval* lval_add(lval* v, lval* x);
+lval* lval_add_n(lval* v, lval** xs, int n);
+lval* lval_reserve(lval* v, int n);
+lval* lval_shrink(lval* v);
+lval* lval_copy(lval* v);
+lval* lval_pop(lval* v, int i);
+lval* lval_take(lval* v, int i);
+
+/* Argument views */
+lval_args lval_args_of(lval* v);
+int lval_args_left(lval_args* a);
+lval* lval_args_take(lval_args* a);
+
+/* Printing */
+void lval_print(lval* v);
+void lval_println(lval* v);
+
+/* Evaluation */
+lval* lval_eval(lenv* e, lval* v);
+lval* lval_call(lenv* e, lval* f, lval* a);
+lval* lval_force(lval* x);
+lval* lval_read(mpc_ast_t* t);
+
+/* Reader; the grammar is built on first use */
+mpc_parser_t* lispy_parser(void);
+void lispy_parser_cleanup(void);
+
+#endif
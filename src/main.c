@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mpc.h"
+#include "lispy.h"
+#include "alloc.h"
+#include "vm.h"
+#include "gc.h"
+#include "fold.h"
+#include "reader.h"
+
+#include <editline/readline.h>
+#include <editline/history.h>
+
+/* Options from the command line */
+static int use_arena = 0;
+static int use_vm = 0;
+static int use_fold = 0;
+static int use_mpc = 0;
+
+/* Read with the built-in reader; NULL after a syntax error */
+static lval* read_text(const char* name, int line, int col,
+                       const char* input, size_t len) {
+    lval* x = lval_read_at(name, line, col, input, len);
+    if (lval_type(x) == LVAL_ERR) {
+        puts(x->err);
+        lval_del(x);
+        return NULL;
+    }
+    return x;
+}
+
+/* The same through the mpc grammar and its AST */
+static lval* read_mpc(const char* name, const char* input) {
+    mpc_result_t r;
+    if (!mpc_parse(name, input, lispy_parser(), &r)) {
+        /* Otherwise print and delete Error */
+        mpc_err_print(r.error);
+        mpc_err_delete(r.error);
+        return NULL;
+    }
+    /* On success convert and delete the AST */
+    lval* x = lval_read(r.output);
+    mpc_ast_delete(r.output);
+    return x;
+}
+
+/* Evaluate 'x' in 'e' and print the result */
+static void eval_print(lenv* e, lval* x) {
+    if (use_fold) {
+        int folded = 0;
+        x = lval_fold(e, x, &folded);
+        if (folded) { fprintf(stderr, "; folded %d\n", folded); }
+    }
+    x = use_vm ? lvm_eval(e, x) : lval_eval(e, x);
+    lval_println(x);
+    lval_del(x);
+}
+
+/**
+ * Run the script at 'path', or standard input for "-", evaluating
+ * each top-level expression as soon as it has been read. Returns 0,
+ * or -1 if it could not be opened.
+ **/
+static int run_script(lenv* e, const char* path) {
+    int from_stdin = strcmp(path, "-") == 0;
+    const char* name = from_stdin ? "<stdin>" : path;
+    int fd = from_stdin ? 0 : open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    lstream* s = lstream_new(fd);
+    const char* form;
+    size_t len;
+    int line, col;
+    while ((form = lstream_next(s, &len, &line, &col))) {
+        lval_arena_set(use_arena);
+        lval* x = use_mpc ? read_mpc(name, form)
+                          : read_text(name, line, col, form, len);
+        /* Each expression on its own, not applied as one S-Expression;
+           those still waiting must stay reachable for the collector */
+        if (x) {
+            int depth = gc_depth();
+            gc_push(x);
+            while (x->count) { eval_print(e, lval_pop(x, 0)); }
+            gc_unwind(depth);
+            lval_del(x);
+        }
+        lval_arena_end();
+    }
+
+    lstream_del(s);
+    if (!from_stdin) { close(fd); }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    /**
+     * --arena: allocate each evaluation in an arena freed after printing,
+     *          and with --mpc build each AST in an arena of its own
+     * --vm:    evaluate through the bytecode VM instead of the tree-walker;
+     *          each form is compiled to be run once, which costs more
+     *          than it saves, so this is for trying the VM out
+     * --fold:  fold constant calls before evaluating, reporting how many
+     * --mpc:   read through the mpc grammar instead of the built-in reader
+     *
+     * Any other arguments are scripts to run in order instead of the
+     * REPL, with "-" for standard input.
+     **/
+    int scripts = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--arena") == 0)     { use_arena = 1; }
+        else if (strcmp(argv[i], "--vm") == 0)   { use_vm = 1; }
+        else if (strcmp(argv[i], "--fold") == 0) { use_fold = 1; }
+        else if (strcmp(argv[i], "--mpc") == 0)  { use_mpc = 1; }
+        else if (strncmp(argv[i], "--", 2) != 0) { scripts++; }
+    }
+
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    mpc_ast_arena_set(use_arena);
+
+    int status = 0;
+    for (int i = 1; i < argc && status == 0; i++) {
+        if (strncmp(argv[i], "--", 2) == 0) { continue; }
+        if (run_script(e, argv[i]) < 0) { status = 1; }
+    }
+
+    /* Print version and exit info */
+    if (!scripts) {
+        puts("Lispy Version 0.0.5");
+        puts("Press Ctrl+c to Exit\n");
+    }
+
+    /* loop */
+    while(!scripts) {
+        char* input = readline("lispy> ");
+
+        /* End of input (Ctrl+d) */
+        if (input == NULL) { putchar('\n'); break; }
+        add_history(input);
+
+        /* Attempt to read; syntax errors are printed by the readers */
+        lval_arena_set(use_arena);
+        lval* x = use_mpc ? read_mpc("<stdin>", input)
+                          : read_text("<stdin>", 1, 1, input, strlen(input));
+        if (x) { eval_print(e, x); }
+        lval_arena_end();
+
+        /* Echo input back yo user */
+        //printf("No, your a %s\n", input);
+
+        /* Free retrieved input */
+        free(input);
+    }
+
+    lenv_clear(e);
+    lenv_del(e);
+    gc_collect();
+    lvm_cleanup();
+    lval_alloc_cleanup();
+    intern_cleanup();
+
+    /* Undef and delete parsers */
+    lispy_parser_cleanup();
+    return status;
+}
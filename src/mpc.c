@@ -1,5 +1,25 @@
+/* Regular files are mapped rather than read where mmap is available */
+#if defined(__unix__) || defined(__APPLE__)
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#define MPC_USE_MMAP
+#endif
+
 #include "mpc.h"
 
+#ifdef MPC_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Runs of a character class are matched 16 bytes at a time with SSE2 */
+#if defined(__SSE2__) && defined(__GNUC__) && !defined(MPC_NO_SIMD)
+#define MPC_USE_SIMD
+#include <emmintrin.h>
+#endif
+
 /*
 ** State Type
 */
@@ -58,7 +78,8 @@ static mpc_state_t mpc_state_new(void) {
 enum {
   MPC_INPUT_STRING = 0,
   MPC_INPUT_FILE   = 1,
-  MPC_INPUT_PIPE   = 2
+  MPC_INPUT_PIPE   = 2,
+  MPC_INPUT_MMAP   = 3
 };
 
 enum {
@@ -69,6 +90,10 @@ enum {
   MPC_INPUT_MEM_NUM = 512
 };
 
+enum {
+  MPC_INPUT_CHUNK = 64 * 1024
+};
+
 typedef struct {
   char mem[64];
 } mpc_mem_t;
@@ -82,6 +107,12 @@ typedef struct {
   char *string;
   char *buffer;
   FILE *file;
+  size_t length;
+  
+  long buffer_pos;
+  size_t buffer_len;
+  size_t buffer_cap;
+  int eof;
   
   int suppress;
   int backtrack;
@@ -92,6 +123,8 @@ typedef struct {
   char *lasts;
   char last;
   
+  struct mpc_memo_t *memo;
+  
   size_t mem_index;
   char mem_full[MPC_INPUT_MEM_NUM];
   mpc_mem_t mem[MPC_INPUT_MEM_NUM];
@@ -108,10 +141,15 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
   
   i->state = mpc_state_new();
   
-  i->string = malloc(strlen(string) + 1);
-  strcpy(i->string, string);
+  /* Read in place; the caller's string outlives the parse */
+  i->string = (char*)string;
+  i->length = strlen(string);
   i->buffer = NULL;
   i->file = NULL;
+  i->buffer_pos = 0;
+  i->buffer_len = 0;
+  i->buffer_cap = 0;
+  i->eof = 0;
   
   i->suppress = 0;
   i->backtrack = 1;
@@ -120,6 +158,7 @@ static mpc_input_t *mpc_input_new_string(const char *filename, const char *strin
   i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
+  i->memo = NULL;
   
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
@@ -137,11 +176,15 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
   
   i->state = mpc_state_new();
   
-  i->string = malloc(length + 1);
-  strncpy(i->string, string, length);
-  i->string[length] = '\0';
+  /* Read in place, NULs and all, with no terminator needed */
+  i->string = (char*)string;
+  i->length = length;
   i->buffer = NULL;
   i->file = NULL;
+  i->buffer_pos = 0;
+  i->buffer_len = 0;
+  i->buffer_cap = 0;
+  i->eof = 0;
   
   i->suppress = 0;
   i->backtrack = 1;
@@ -150,6 +193,7 @@ static mpc_input_t *mpc_input_new_nstring(const char *filename, const char *stri
   i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
+  i->memo = NULL;
   
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
@@ -171,6 +215,10 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
   i->string = NULL;
   i->buffer = NULL;
   i->file = pipe;
+  i->buffer_pos = 0;
+  i->buffer_len = 0;
+  i->buffer_cap = 0;
+  i->eof = 0;
   
   i->suppress = 0;
   i->backtrack = 1;
@@ -179,6 +227,7 @@ static mpc_input_t *mpc_input_new_pipe(const char *filename, FILE *pipe) {
   i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
+  i->memo = NULL;
   
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
@@ -199,6 +248,63 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
   i->string = NULL;
   i->buffer = NULL;
   i->file = file;
+  i->buffer_pos = 0;
+  i->buffer_len = 0;
+  i->buffer_cap = 0;
+  i->eof = 0;
+  
+  i->suppress = 0;
+  i->backtrack = 1;
+  i->marks_num = 0;
+  i->marks_slots = MPC_INPUT_MARKS_MIN;
+  i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
+  i->lasts = malloc(sizeof(char) * i->marks_slots);
+  i->last = '\0';
+  i->memo = NULL;
+  
+  i->mem_index = 0;
+  memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
+  
+  return i;
+}
+
+#ifdef MPC_USE_MMAP
+
+/*
+** A regular file mapped whole and read in place like a string. The
+** mapping has no terminating NUL, so reads are checked against its
+** length instead. NULL if 'file' can't be mapped, for the caller to
+** read it as a FILE instead; it is not opened again, as a FIFO would
+** then wait for a writer that has already gone.
+*/
+static mpc_input_t *mpc_input_new_mmap(const char *filename, FILE *file) {
+
+  mpc_input_t *i;
+  struct stat st;
+  void *m;
+  int fd = fileno(file);
+  
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) { return NULL; }
+  
+  m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (m == MAP_FAILED) { return NULL; }
+  
+  i = malloc(sizeof(mpc_input_t));
+  
+  i->filename = malloc(strlen(filename) + 1);
+  strcpy(i->filename, filename);
+  i->type = MPC_INPUT_MMAP;
+  
+  i->state = mpc_state_new();
+  
+  i->string = m;
+  i->length = (size_t)st.st_size;
+  i->buffer = NULL;
+  i->file = NULL;
+  i->buffer_pos = 0;
+  i->buffer_len = 0;
+  i->buffer_cap = 0;
+  i->eof = 0;
   
   i->suppress = 0;
   i->backtrack = 1;
@@ -207,6 +313,7 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
   i->marks = malloc(sizeof(mpc_state_t) * i->marks_slots);
   i->lasts = malloc(sizeof(char) * i->marks_slots);
   i->last = '\0';
+  i->memo = NULL;
   
   i->mem_index = 0;
   memset(i->mem_full, 0, sizeof(char) * MPC_INPUT_MEM_NUM);
@@ -214,12 +321,30 @@ static mpc_input_t *mpc_input_new_file(const char *filename, FILE *file) {
   return i;
 }
 
+#else
+
+static mpc_input_t *mpc_input_new_mmap(const char *filename, FILE *file) {
+  (void) filename; (void) file;
+  return NULL;
+}
+
+#endif
+
+static void mpc_memo_delete(mpc_input_t *i);
+
 static void mpc_input_delete(mpc_input_t *i) {
   
   free(i->filename);
+  mpc_memo_delete(i);
   
-  if (i->type == MPC_INPUT_STRING) { free(i->string); }
-  if (i->type == MPC_INPUT_PIPE) { free(i->buffer); }
+  /* Leave a file just after what was read from it */
+  if (i->type == MPC_INPUT_FILE) {
+    fseek(i->file, i->state.pos - (i->buffer_pos + (long)i->buffer_len), SEEK_CUR);
+  }
+  free(i->buffer);
+#ifdef MPC_USE_MMAP
+  if (i->type == MPC_INPUT_MMAP) { munmap(i->string, i->length); }
+#endif
   
   free(i->marks);
   free(i->lasts);
@@ -311,10 +436,6 @@ static void mpc_input_mark(mpc_input_t *i) {
   i->marks[i->marks_num-1] = i->state;
   i->lasts[i->marks_num-1] = i->last;
   
-  if (i->type == MPC_INPUT_PIPE && i->marks_num == 1) {
-    i->buffer = calloc(1, 1);
-  }
-  
 }
 
 static void mpc_input_unmark(mpc_input_t *i) {
@@ -332,11 +453,6 @@ static void mpc_input_unmark(mpc_input_t *i) {
     i->lasts = realloc(i->lasts, sizeof(char) * i->marks_slots);      
   }
   
-  if (i->type == MPC_INPUT_PIPE && i->marks_num == 0) {
-    free(i->buffer);
-    i->buffer = NULL;
-  }
-  
 }
 
 static void mpc_input_rewind(mpc_input_t *i) {
@@ -346,118 +462,97 @@ static void mpc_input_rewind(mpc_input_t *i) {
   i->state = i->marks[i->marks_num-1];
   i->last  = i->lasts[i->marks_num-1];
   
-  if (i->type == MPC_INPUT_FILE) {
-    fseek(i->file, i->state.pos, SEEK_SET);
-  }
-  
   mpc_input_unmark(i);
 }
 
-static int mpc_input_buffer_in_range(mpc_input_t *i) {
-  return i->state.pos < (long)(strlen(i->buffer) + i->marks[0].pos);
+/*
+** FILE and pipe inputs are read a block at a time into a window,
+** 'buffer', holding the stream from 'buffer_pos' on. Nothing before
+** the oldest mark can be rewound to, so that much of the window is
+** dropped to make room whenever more is read, and a rewind is only a
+** change of 'pos'. Files are read in whole blocks. Pipes stop at the
+** end of a line, so interactive input is parsed as it is typed. Both
+** may read past the end of what is parsed; a file is put back after.
+*/
+
+static int mpc_input_buffer_fill(mpc_input_t *i) {
+  
+  long keep = i->marks_num > 0 ? i->marks[0].pos : i->state.pos;
+  size_t drop = (size_t)(keep - i->buffer_pos);
+  size_t n = 0;
+  int c;
+  
+  if (i->eof) { return 0; }
+  
+  /* Moving the kept bytes down costs no more than was dropped */
+  if (drop > 0 && drop >= i->buffer_len / 2
+  &&  i->buffer_cap - i->buffer_len < MPC_INPUT_CHUNK) {
+    memmove(i->buffer, i->buffer + drop, i->buffer_len - drop);
+    i->buffer_len -= drop;
+    i->buffer_pos = keep;
+  }
+  
+  if (i->buffer_cap - i->buffer_len < MPC_INPUT_CHUNK) {
+    i->buffer_cap = i->buffer_cap ? i->buffer_cap * 2 : MPC_INPUT_CHUNK;
+    i->buffer = realloc(i->buffer, i->buffer_cap);
+  }
+  
+  if (i->type == MPC_INPUT_FILE) {
+    n = fread(i->buffer + i->buffer_len, 1, MPC_INPUT_CHUNK, i->file);
+  } else {
+    while (n < MPC_INPUT_CHUNK && (c = getc(i->file)) != EOF) {
+      i->buffer[i->buffer_len + n++] = (char)c;
+      if (c == '\n') { break; }
+    }
+  }
+  
+  if (n == 0) { i->eof = 1; return 0; }
+  i->buffer_len += n;
+  return 1;
 }
 
-static char mpc_input_buffer_get(mpc_input_t *i) {
-  return i->buffer[i->state.pos - i->marks[0].pos];
+/* True if the byte at 'pos' is in the window, reading more if needed */
+static int mpc_input_buffer_has(mpc_input_t *i) {
+  return i->state.pos < i->buffer_pos + (long)i->buffer_len
+      || mpc_input_buffer_fill(i);
 }
 
 static int mpc_input_terminated(mpc_input_t *i) {
-  if (i->type == MPC_INPUT_STRING && i->state.pos == (long)strlen(i->string)) { return 1; }
-  if (i->type == MPC_INPUT_FILE && feof(i->file)) { return 1; }
-  if (i->type == MPC_INPUT_PIPE && feof(i->file)) { return 1; }
+  if (i->type == MPC_INPUT_STRING && i->state.pos == (long)i->length) { return 1; }
+  if (i->type == MPC_INPUT_MMAP && i->state.pos == (long)i->length) { return 1; }
+  if (i->type == MPC_INPUT_FILE && !mpc_input_buffer_has(i)) { return 1; }
+  if (i->type == MPC_INPUT_PIPE && !mpc_input_buffer_has(i)) { return 1; }
   return 0;
 }
 
 static char mpc_input_getc(mpc_input_t *i) {
   
-  char c = '\0';
-  
   switch (i->type) {
     
-    case MPC_INPUT_STRING: return i->string[i->state.pos];
-    case MPC_INPUT_FILE: c = fgetc(i->file); return c;
+    case MPC_INPUT_STRING:
+    case MPC_INPUT_MMAP:
+      return i->state.pos < (long)i->length ? i->string[i->state.pos] : '\0';
+    case MPC_INPUT_FILE:
     case MPC_INPUT_PIPE:
+      if (!mpc_input_buffer_has(i)) { return '\0'; }
+      return i->buffer[i->state.pos - i->buffer_pos];
     
-      if (!i->buffer) { c = getc(i->file); return c; }
-      
-      if (i->buffer && mpc_input_buffer_in_range(i)) {
-        c = mpc_input_buffer_get(i);
-        return c;
-      } else {
-        c = getc(i->file);
-        return c;
-      }
-    
-    default: return c;
+    default: return '\0';
   }
 }
 
+/* Reading never consumes anything; only mpc_input_success moves on */
 static char mpc_input_peekc(mpc_input_t *i) {
-  
-  char c = '\0';
-  
-  switch (i->type) {
-    case MPC_INPUT_STRING: return i->string[i->state.pos];
-    case MPC_INPUT_FILE: 
-      
-      c = fgetc(i->file);
-      if (feof(i->file)) { return '\0'; }
-      
-      fseek(i->file, -1, SEEK_CUR);
-      return c;
-    
-    case MPC_INPUT_PIPE:
-      
-      if (!i->buffer) {
-        c = getc(i->file);
-        if (feof(i->file)) { return '\0'; }
-        ungetc(c, i->file);
-        return c;
-      }
-      
-      if (i->buffer && mpc_input_buffer_in_range(i)) {
-        return mpc_input_buffer_get(i);
-      } else {
-        c = getc(i->file);
-        if (feof(i->file)) { return '\0'; }
-        ungetc(c, i->file);
-        return c;
-      }
-    
-    default: return c;
-  }
-  
+  return mpc_input_getc(i);
 }
 
 static int mpc_input_failure(mpc_input_t *i, char c) {
-
-  switch (i->type) {
-    case MPC_INPUT_STRING: { break; }
-    case MPC_INPUT_FILE: fseek(i->file, -1, SEEK_CUR); { break; }
-    case MPC_INPUT_PIPE: {
-      
-      if (!i->buffer) { ungetc(c, i->file); break; }
-      
-      if (i->buffer && mpc_input_buffer_in_range(i)) {
-        break;
-      } else {
-        ungetc(c, i->file); 
-      }
-    }
-    default: { break; }
-  }
+  (void) i; (void) c;
   return 0;
 }
 
 static int mpc_input_success(mpc_input_t *i, char c, char **o) {
   
-  if (i->type == MPC_INPUT_PIPE
-  &&  i->buffer && !mpc_input_buffer_in_range(i)) {
-    i->buffer = realloc(i->buffer, strlen(i->buffer) + 2);
-    i->buffer[strlen(i->buffer) + 1] = '\0';
-    i->buffer[strlen(i->buffer) + 0] = c;
-  }
-  
   i->last = c;
   i->state.pos++;
   i->state.col++;
@@ -494,16 +589,12 @@ static int mpc_input_range(mpc_input_t *i, char c, char d, char **o) {
   return x >= c && x <= d ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
 }
 
-static int mpc_input_oneof(mpc_input_t *i, const char *c, char **o) {
-  char x = mpc_input_getc(i);
-  if (mpc_input_terminated(i)) { return 0; }
-  return strchr(c, x) != 0 ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
-}
+#define MPC_CLASS_HAS(bits, c) ((bits)[(unsigned char)(c) >> 3] & (1 << ((unsigned char)(c) & 7)))
 
-static int mpc_input_noneof(mpc_input_t *i, const char *c, char **o) {
+static int mpc_input_class(mpc_input_t *i, const unsigned char *bits, char **o) {
   char x = mpc_input_getc(i);
   if (mpc_input_terminated(i)) { return 0; }
-  return strchr(c, x) == 0 ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
+  return MPC_CLASS_HAS(bits, x) ? mpc_input_success(i, x, o) : mpc_input_failure(i, x);  
 }
 
 static int mpc_input_satisfy(mpc_input_t *i, int(*cond)(char), char **o) {
@@ -536,6 +627,42 @@ static int mpc_input_anchor(mpc_input_t* i, int(*f)(char,char), char **o) {
   return f(i->last, mpc_input_peekc(i));
 }
 
+/*
+** Bulk scanning. Repeating a parser that matches one character at a
+** time costs a call, a result and an allocation per character. These
+** let mpc_parse_run_span take a whole run of matches at once instead.
+*/
+
+/* The bytes from 'pos' on that can be read without waiting for more */
+static const char *mpc_input_window(mpc_input_t *i, size_t *n) {
+  switch (i->type) {
+    case MPC_INPUT_STRING:
+    case MPC_INPUT_MMAP:
+      *n = i->length - (size_t)i->state.pos;
+      return i->string + i->state.pos;
+    case MPC_INPUT_FILE:
+    case MPC_INPUT_PIPE:
+      if (!mpc_input_buffer_has(i)) { *n = 0; return NULL; }
+      *n = i->buffer_len - (size_t)(i->state.pos - i->buffer_pos);
+      return i->buffer + (i->state.pos - i->buffer_pos);
+    default:
+      *n = 0;
+      return NULL;
+  }
+}
+
+/* Move past the 'k' bytes at 's', which are the next in the input */
+static void mpc_input_advance(mpc_input_t *i, const char *s, size_t k) {
+  const char *end = s + k, *q = s, *nl;
+  while ((nl = memchr(q, '\n', (size_t)(end - q)))) {
+    i->state.row++;
+    q = nl + 1;
+  }
+  i->state.col = q == s ? i->state.col + (long)k : (long)(end - q);
+  i->state.pos += (long)k;
+  i->last = s[k-1];
+}
+
 static mpc_state_t *mpc_input_state_copy(mpc_input_t *i) {
   mpc_state_t *r = mpc_malloc(i, sizeof(mpc_state_t));
   memcpy(r, &i->state, sizeof(mpc_state_t));
@@ -703,6 +830,30 @@ static mpc_err_t *mpc_err_export(mpc_input_t *i, mpc_err_t *x) {
   return mpc_export(i, x);
 }
 
+static mpc_err_t *mpc_err_copy(mpc_input_t *i, mpc_err_t *x) {
+  int j;
+  mpc_err_t *y;
+  if (x == NULL) { return NULL; }
+  y = mpc_malloc(i, sizeof(mpc_err_t));
+  *y = *x;
+  y->filename = mpc_malloc(i, strlen(x->filename) + 1);
+  strcpy(y->filename, x->filename);
+  y->failure = NULL;
+  if (x->failure) {
+    y->failure = mpc_malloc(i, strlen(x->failure) + 1);
+    strcpy(y->failure, x->failure);
+  }
+  y->expected = NULL;
+  if (x->expected_num) {
+    y->expected = mpc_malloc(i, sizeof(char*) * x->expected_num);
+  }
+  for (j = 0; j < x->expected_num; j++) {
+    y->expected[j] = mpc_malloc(i, strlen(x->expected[j]) + 1);
+    strcpy(y->expected[j], x->expected[j]);
+  }
+  return y;
+}
+
 static int mpc_err_contains_expected(mpc_input_t *i, mpc_err_t *x, char *expected) {
   int j;
   (void)i;
@@ -882,7 +1033,9 @@ enum {
   MPC_TYPE_COUNT     = 22,
   
   MPC_TYPE_OR        = 23,
-  MPC_TYPE_AND       = 24
+  MPC_TYPE_AND       = 24,
+  
+  MPC_TYPE_DFA       = 25
 };
 
 typedef struct { char *m; } mpc_pdata_fail_t;
@@ -892,14 +1045,26 @@ typedef struct { int(*f)(char,char); } mpc_pdata_anchor_t;
 typedef struct { char x; } mpc_pdata_single_t;
 typedef struct { char x; char y; } mpc_pdata_range_t;
 typedef struct { int(*f)(char); } mpc_pdata_satisfy_t;
-typedef struct { char *x; } mpc_pdata_string_t;
+enum { MPC_CLASS_RANGES_MAX = 8 };
+
+/*
+** ONEOF and NONEOF also keep the bytes they match as a bitmap, and
+** as up to MPC_CLASS_RANGES_MAX ranges (none if it takes more).
+*/
+typedef struct {
+  char *x;
+  unsigned char bits[32];
+  unsigned char ranges[2 * MPC_CLASS_RANGES_MAX];
+  unsigned char ranges_num;
+} mpc_pdata_string_t;
 typedef struct { mpc_parser_t *x; mpc_apply_t f; } mpc_pdata_apply_t;
 typedef struct { mpc_parser_t *x; mpc_apply_to_t f; void *d; } mpc_pdata_apply_to_t;
 typedef struct { mpc_parser_t *x; } mpc_pdata_predict_t;
 typedef struct { mpc_parser_t *x; mpc_dtor_t dx; mpc_ctor_t lf; } mpc_pdata_not_t;
 typedef struct { int n; mpc_fold_t f; mpc_parser_t *x; mpc_dtor_t dx; } mpc_pdata_repeat_t;
-typedef struct { int n; mpc_parser_t **xs; } mpc_pdata_or_t;
+typedef struct { int n; mpc_parser_t **xs; struct mpc_or_table_t *t; } mpc_pdata_or_t;
 typedef struct { int n; mpc_fold_t f; mpc_parser_t **xs; mpc_dtor_t *dxs;  } mpc_pdata_and_t;
+typedef struct { mpc_parser_t *x; struct mpc_dfa_t *d; } mpc_pdata_dfa_t;
 
 typedef union {
   mpc_pdata_fail_t fail;
@@ -917,13 +1082,20 @@ typedef union {
   mpc_pdata_repeat_t repeat;
   mpc_pdata_and_t and;
   mpc_pdata_or_t or;
+  mpc_pdata_dfa_t dfa;
 } mpc_pdata_t;
 
 struct mpc_parser_t {
   char retained;
+  char memo;
   char *name;
   char type;
+  int id;
   mpc_pdata_t data;
+  struct mpc_tags_t *tags;
+  unsigned long memo_lookups;
+  unsigned long memo_hits;
+  unsigned long memo_evicted;
 };
 
 static mpc_val_t *mpcf_input_nth_free(mpc_input_t *i, int n, mpc_val_t **xs, int x) {
@@ -939,10 +1111,17 @@ static mpc_val_t *mpcf_input_trd_free(mpc_input_t *i, int n, mpc_val_t **xs) { r
 static mpc_val_t *mpcf_input_strfold(mpc_input_t *i, int n, mpc_val_t **xs) {
   int j;
   size_t l = 0;
+  size_t m;
   if (n == 0) { return mpc_calloc(i, 1, 1); }
   for (j = 0; j < n; j++) { l += strlen(xs[j]); }
+  m = strlen(xs[0]);
   xs[0] = mpc_realloc(i, xs[0], l + 1);
-  for (j = 1; j < n; j++) { strcat(xs[0], xs[j]); mpc_free(i, xs[j]); }
+  for (j = 1; j < n; j++) {
+    size_t lj = strlen(xs[j]);
+    memcpy((char*)xs[0] + m, xs[j], lj + 1);
+    m += lj;
+    mpc_free(i, xs[j]);
+  }
   return xs[0];
 }
 
@@ -1006,12 +1185,672 @@ enum {
   if (x) { MPC_SUCCESS(r->output); } \
   else { MPC_FAILURE(NULL); }
 
+/* The parser under any 'expect' if it matches one character, else NULL */
+static mpc_parser_t *mpc_char_parser(mpc_parser_t *p) {
+  while (p->type == MPC_TYPE_EXPECT) { p = p->data.expect.x; }
+  switch (p->type) {
+    case MPC_TYPE_ANY:
+    case MPC_TYPE_SINGLE:
+    case MPC_TYPE_RANGE:
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+    case MPC_TYPE_SATISFY:
+      return p;
+    default:
+      return NULL;
+  }
+}
+
+/*
+** How many of the 'n' bytes at 's' fall in the 'num' ranges 'r', taken
+** 16 at a time; stops at the first that does not, or short of the end.
+** A byte is in [lo, hi] if, less lo, it is at most hi - lo unsigned,
+** which SSE2 only compares signed, so both sides have their top bit
+** flipped first.
+*/
+static size_t mpc_run_blocks(const unsigned char *r, int num, const char *s, size_t n) {
+  
+#ifdef MPC_USE_SIMD
+  
+  __m128i lo[MPC_CLASS_RANGES_MAX], width[MPC_CLASS_RANGES_MAX];
+  __m128i top = _mm_set1_epi8((char)0x80);
+  __m128i v, d, out;
+  size_t k = 0;
+  int j, mask;
+  
+  if (num == 0) { return 0; }
+  
+  for (j = 0; j < num; j++) {
+    lo[j] = _mm_set1_epi8((char)r[2*j]);
+    width[j] = _mm_set1_epi8((char)((r[2*j+1] - r[2*j]) ^ 0x80));
+  }
+  
+  for (; k + 16 <= n; k += 16) {
+    v = _mm_loadu_si128((const __m128i*)(s + k));
+    out = _mm_set1_epi8((char)0xFF);
+    for (j = 0; j < num; j++) {
+      d = _mm_xor_si128(_mm_sub_epi8(v, lo[j]), top);
+      out = _mm_and_si128(out, _mm_cmpgt_epi8(d, width[j]));
+    }
+    mask = _mm_movemask_epi8(out);
+    if (mask) { return k + (size_t)__builtin_ctz((unsigned)mask); }
+  }
+  return k;
+  
+#else
+  (void) r; (void) num; (void) s; (void) n;
+  return 0;
+#endif
+  
+}
+
+/* The bytes from 'x' to 'y' as compared by RANGE, which is signed */
+static int mpc_range_ranges(char x, char y, unsigned char *r) {
+  if (x > y) { return 0; }
+  if (x < 0 && y >= 0) {
+    r[0] = 0; r[1] = (unsigned char)y;
+    r[2] = (unsigned char)x; r[3] = 0xFF;
+    return 2;
+  }
+  r[0] = (unsigned char)x; r[1] = (unsigned char)y;
+  return 1;
+}
+
+/* How many of the 'n' bytes at 's' character parser 'p' matches in a row */
+static size_t mpc_run_length(mpc_parser_t *p, const char *s, size_t n) {
+  
+  size_t k = 0;
+  const char *c = p->data.string.x;
+  const unsigned char *bits = p->data.string.bits;
+  const char *q;
+  unsigned char r[4];
+  
+  switch (p->type) {
+    case MPC_TYPE_ANY: return n;
+    case MPC_TYPE_SINGLE:
+      r[0] = r[1] = (unsigned char)p->data.single.x;
+      k = mpc_run_blocks(r, 1, s, n);
+      while (k < n && s[k] == p->data.single.x) { k++; }
+      return k;
+    case MPC_TYPE_RANGE:
+      k = mpc_run_blocks(r, mpc_range_ranges(p->data.range.x, p->data.range.y, r), s, n);
+      while (k < n && s[k] >= p->data.range.x && s[k] <= p->data.range.y) { k++; }
+      return k;
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      /* Everything up to one character, as in strings and comments */
+      if (p->type == MPC_TYPE_NONEOF && c[0] && !c[1]) {
+        q = memchr(s, c[0], n);
+        return q ? (size_t)(q - s) : n;
+      }
+      k = mpc_run_blocks(p->data.string.ranges, p->data.string.ranges_num, s, n);
+      while (k < n && MPC_CLASS_HAS(bits, s[k])) { k++; }
+      return k;
+    case MPC_TYPE_SATISFY:
+      while (k < n && p->data.satisfy.f(s[k])) { k++; }
+      return k;
+    default: return 0;
+  }
+}
+
+/* Consume the run character parser 'p' matches from here as one string; 0 if empty */
+static int mpc_input_run(mpc_input_t *i, mpc_parser_t *p, char **o) {
+  
+  const char *s;
+  char *out = NULL;
+  size_t n, k, len = 0;
+  
+  while ((s = mpc_input_window(i, &n)) && n > 0) {
+    k = mpc_run_length(p, s, n);
+    if (k > 0) {
+      out = out ? mpc_realloc(i, out, len + k + 1) : mpc_malloc(i, k + 1);
+      memcpy(out + len, s, k);
+      len += k;
+      mpc_input_advance(i, s, k);
+    }
+    if (k < n) { break; }
+  }
+  
+  if (len == 0) { return 0; }
+  out[len] = '\0';
+  *o = out;
+  return 1;
+}
+
+static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e);
+
+/*
+** A many or many1 of one character at a time, folded into a string,
+** is taken as a single run. The parser is still run once where the
+** run stops, so the error it leaves is the same as the long way.
+** Returns 0, having read nothing, for the long way to take over.
+*/
+static int mpc_parse_run_span(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e) {
+  
+  mpc_parser_t *c = mpc_char_parser(p->data.repeat.x);
+  mpc_result_t stop;
+  char *s;
+  
+  if (c == NULL || p->data.repeat.f != mpcf_strfold) { return 0; }
+  if (!mpc_input_run(i, c, &s)) { return 0; }
+  
+  if (mpc_parse_run(i, p->data.repeat.x, &stop, e)) {
+    /* Only reached if the run and the parser disagree */
+    mpc_free(i, s);
+    mpc_free(i, stop.output);
+    return 0;
+  }
+  
+  *e = mpc_err_merge(i, *e, stop.error);
+  r->output = s;
+  return 1;
+}
+
+/*
+** A regex compiled by mpc_re into a table, see mpc_re_dfa. State
+** 0 is dead and state 1 the start; the rest stand for the characters
+** of the regex, so at most one is ever live and the longest match is
+** the one the combinators would have found.
+*/
+
+typedef struct mpc_dfa_t {
+  int states;
+  unsigned char *next;
+  char *accept;
+  /* If stopping in each state leaves the error the combinators would */
+  char *exact;
+  /* What each state could have read next, by index into 'names' */
+  int *expected_start;
+  int *expected;
+  char **names;
+  int names_num;
+  /* Anchors at the very start and end of the regex */
+  int(*soi)(char,char);
+  int(*eoi)(char,char);
+  /* Errors for failing on the first character, the same every time */
+  int failed;
+  mpc_err_t *fail_error;
+  mpc_err_t *fail_merged;
+} mpc_dfa_t;
+
+static void mpc_dfa_delete(mpc_dfa_t *d) {
+  int j;
+  for (j = 0; j < d->names_num; j++) { free(d->names[j]); }
+  if (d->fail_error) { mpc_err_delete(d->fail_error); }
+  if (d->fail_merged) { mpc_err_delete(d->fail_merged); }
+  free(d->names);
+  free(d->expected);
+  free(d->expected_start);
+  free(d->exact);
+  free(d->accept);
+  free(d->next);
+  free(d);
+}
+
+static mpc_dfa_t *mpc_dfa_copy(mpc_dfa_t *a) {
+  int j, n = a->expected_start[a->states];
+  mpc_dfa_t *d = malloc(sizeof(mpc_dfa_t));
+  memcpy(d, a, sizeof(mpc_dfa_t));
+  d->next = malloc(a->states * 256);
+  memcpy(d->next, a->next, a->states * 256);
+  d->accept = malloc(a->states);
+  memcpy(d->accept, a->accept, a->states);
+  d->exact = malloc(a->states);
+  memcpy(d->exact, a->exact, a->states);
+  d->expected_start = malloc(sizeof(int) * (a->states + 1));
+  memcpy(d->expected_start, a->expected_start, sizeof(int) * (a->states + 1));
+  d->expected = malloc(sizeof(int) * (n ? n : 1));
+  memcpy(d->expected, a->expected, sizeof(int) * n);
+  d->names = malloc(sizeof(char*) * (a->names_num ? a->names_num : 1));
+  for (j = 0; j < a->names_num; j++) {
+    d->names[j] = malloc(strlen(a->names[j]) + 1);
+    strcpy(d->names[j], a->names[j]);
+  }
+  d->failed = 0;
+  d->fail_error = NULL;
+  d->fail_merged = NULL;
+  return d;
+}
+
+/* A copy of error 'x' made at the current position */
+static mpc_err_t *mpc_err_here(mpc_input_t *i, mpc_err_t *x) {
+  mpc_err_t *y = mpc_err_copy(i, x);
+  if (y == NULL) { return NULL; }
+  mpc_free(i, y->filename);
+  y->filename = mpc_malloc(i, strlen(i->filename) + 1);
+  strcpy(y->filename, i->filename);
+  y->state = i->state;
+  y->recieved = mpc_input_peekc(i);
+  return y;
+}
+
+/* The error the combinators leave after a match that stopped in state 's' */
+static mpc_err_t *mpc_dfa_err_stop(mpc_input_t *i, mpc_dfa_t *d, int s) {
+  int j;
+  mpc_err_t *x;
+  if (d->expected_start[s] == d->expected_start[s+1]) { return NULL; }
+  x = mpc_err_new(i, d->names[d->expected[d->expected_start[s]]]);
+  for (j = d->expected_start[s] + 1; j < d->expected_start[s+1]; j++) {
+    mpc_err_add_expected(i, x, d->names[d->expected[j]]);
+  }
+  return x;
+}
+
+static int mpc_parse_dfa_fail(mpc_input_t *i, mpc_dfa_t *d, mpc_parser_t *x, mpc_result_t *r, mpc_err_t **e) {
+  
+  mpc_err_t *m = NULL;
+  int ok;
+  
+  if (i->suppress) { r->error = NULL; return 0; }
+  
+  if (d->failed) {
+    r->error = mpc_err_here(i, d->fail_error);
+    if (d->fail_merged) { *e = mpc_err_merge(i, *e, mpc_err_here(i, d->fail_merged)); }
+    return 0;
+  }
+  
+  /* The first time, find out from the combinators what to report */
+  ok = mpc_parse_run(i, x, r, &m);
+  if (!ok && !d->soi) {
+    d->failed = 1;
+    d->fail_error = r->error ? mpc_err_export(i, mpc_err_copy(i, r->error)) : NULL;
+    d->fail_merged = m ? mpc_err_export(i, mpc_err_copy(i, m)) : NULL;
+  }
+  if (m) { *e = mpc_err_merge(i, *e, m); }
+  return ok;
+}
+
+static int mpc_parse_dfa(mpc_input_t *i, mpc_dfa_t *d, mpc_parser_t *x, mpc_result_t *r, mpc_err_t **e) {
+  
+  const unsigned char *next = d->next;
+  const char *w;
+  size_t n, k = 0, taken = 0;
+  long q = d->accept[1] ? 0 : -1;
+  long t;
+  int s = 1, u;
+  int buffered = i->type == MPC_INPUT_FILE || i->type == MPC_INPUT_PIPE;
+  mpc_state_t sq;
+  char lq, prev, nextc;
+  mpc_err_t *stop;
+  char *out;
+  
+  /* Overrunning a match has to be undone, which takes backtracking */
+  if (i->backtrack < 1) { return mpc_parse_run(i, x, r, e); }
+  
+  if (d->soi && !d->soi(i->last, mpc_input_peekc(i))) { return mpc_parse_run(i, x, r, e); }
+  
+  /* A buffered input is read through as it runs, then rewound */
+  if (buffered) { mpc_input_mark(i); }
+  
+  while (1) {
+    w = mpc_input_window(i, &n);
+    for (k = 0; k < n; k++) {
+      u = next[s * 256 + (unsigned char)w[k]];
+      if (u == 0) { break; }
+      s = u;
+      if (d->accept[s]) { q = (long)(taken + k + 1); }
+    }
+    if (!buffered || k < n || n == 0) { break; }
+    mpc_input_advance(i, w, n);
+    taken += n;
+  }
+  
+  /* 's' is where it stopped, 't' bytes in */
+  t = (long)(taken + k);
+  if (buffered) {
+    mpc_input_rewind(i);
+    w = mpc_input_window(i, &n);
+  }
+  
+  if (q >= 0 && d->eoi) {
+    prev = q > 0 ? w[q-1] : i->last;
+    nextc = (size_t)q < n ? w[q] : '\0';
+    if (!d->eoi(prev, nextc)) { q = -1; }
+  }
+  
+  if (q < 0) {
+    if (t == 0) { return mpc_parse_dfa_fail(i, d, x, r, e); }
+    return mpc_parse_run(i, x, r, e);
+  }
+  
+  if (!d->exact[s] && !i->suppress) { return mpc_parse_run(i, x, r, e); }
+  
+  out = mpc_malloc(i, (size_t)q + 1);
+  out[q] = '\0';
+  if (q > 0) {
+    memcpy(out, w, (size_t)q);
+    mpc_input_advance(i, w, (size_t)q);
+  }
+  r->output = out;
+  
+  /* Report what could have come next, from where it stopped */
+  if (i->suppress || (*e && (*e)->state.pos > i->state.pos + (t - q))) { return 1; }
+  if (t == q) {
+    stop = mpc_dfa_err_stop(i, d, s);
+  } else {
+    sq = i->state;
+    lq = i->last;
+    mpc_input_advance(i, w + q, (size_t)(t - q));
+    stop = mpc_dfa_err_stop(i, d, s);
+    i->state = sq;
+    i->last = lq;
+  }
+  if (stop) { *e = mpc_err_merge(i, *e, stop); }
+  
+  return 1;
+}
+
+/*
+** First character dispatch for 'or'. An alternative that has to read
+** something, and cannot start with the next character, fails there
+** without reading anything, so it is not tried; mpc_or_table works out
+** which those are over the whole parser graph. What it would have reported
+** is the same every time but for where, so it is kept from the first
+** time and merged in its place after that. The rest are still tried
+** in order.
+*/
+
+typedef struct {
+  int failed;
+  mpc_err_t *error;
+  mpc_err_t *merged;
+} mpc_or_skip_t;
+
+typedef struct mpc_or_table_t {
+  unsigned long gen;
+  /* The first alternative worth trying on each character, up to 255 */
+  unsigned char start[256];
+  /* 32 bytes an alternative, for the characters it is tried on */
+  unsigned char *viable;
+  mpc_or_skip_t *skips;
+  /* By start, the failures of every alternative before it merged into one */
+  mpc_or_skip_t *leads;
+} mpc_or_table_t;
+
+/* Moved on whenever parsers are redefined, leaving every table out of date */
+static unsigned long mpc_or_gen = 1;
+
+static void mpc_or_table_delete(mpc_or_table_t *t, int n) {
+  int j;
+  if (t == NULL) { return; }
+  for (j = 0; j < n; j++) {
+    if (t->skips[j].error) { mpc_err_delete(t->skips[j].error); }
+    if (t->skips[j].merged) { mpc_err_delete(t->skips[j].merged); }
+  }
+  for (j = 0; j <= n; j++) {
+    if (t->leads[j].error) { mpc_err_delete(t->leads[j].error); }
+  }
+  free(t->leads);
+  free(t->skips);
+  free(t->viable);
+  free(t);
+}
+
+static mpc_or_table_t *mpc_or_table(mpc_parser_t *p);
+
+/* Fail as alternative 'x' would have, without trying it if it has failed here before */
+static int mpc_parse_or_skip(mpc_input_t *i, mpc_or_skip_t *s, mpc_parser_t *x, mpc_result_t *r, mpc_err_t **e) {
+  
+  mpc_err_t *m = NULL;
+  int ok;
+  
+  if (s->failed) {
+    r->error = mpc_err_here(i, s->error);
+    if (s->merged) { *e = mpc_err_merge(i, *e, mpc_err_here(i, s->merged)); }
+    return 0;
+  }
+  
+  ok = mpc_parse_run(i, x, r, &m);
+  if (!ok && !i->suppress) {
+    s->failed = 1;
+    s->error = r->error ? mpc_err_export(i, mpc_err_copy(i, r->error)) : NULL;
+    s->merged = m ? mpc_err_export(i, mpc_err_copy(i, m)) : NULL;
+  }
+  if (m) { *e = mpc_err_merge(i, *e, m); }
+  return ok;
+}
+
+/*
+** Fail as every alternative before 'j' would have, all at once. That
+** needs each to have failed here on its own before; until then it
+** returns 0 and they are gone through one by one.
+*/
+static int mpc_parse_or_lead(mpc_input_t *i, mpc_or_table_t *t, int j, mpc_err_t **e) {
+  
+  mpc_or_skip_t *l = &t->leads[j];
+  mpc_err_t *m = NULL;
+  int k;
+  
+  if (!l->failed) {
+    for (k = 0; k < j; k++) {
+      if (!t->skips[k].failed) { return 0; }
+    }
+    for (k = 0; k < j; k++) {
+      if (t->skips[k].merged) { m = mpc_err_merge(i, m, mpc_err_here(i, t->skips[k].merged)); }
+      m = mpc_err_merge(i, m, mpc_err_here(i, t->skips[k].error));
+    }
+    l->failed = 1;
+    l->error = m ? mpc_err_export(i, m) : NULL;
+  }
+  
+  if (l->error) { *e = mpc_err_merge(i, *e, mpc_err_here(i, l->error)); }
+  return 1;
+}
+
+/*
+** Packrat memoization. A rule marked '@memo' in mpca_lang remembers
+** what it did at each position: where it stopped, a copy of the AST
+** it built or of the error it failed with, and the errors it merged on
+** the way. When an alternative backtracks and the rule is tried at the
+** same position again, that is replayed instead of parsed.
+**
+** Entries count against mpc_memo_set_budget. Over it, the entries
+** before the earliest mark go first, since nothing can rewind to
+** them; if that is not enough the table starts over empty.
+*/
+
+typedef struct {
+  mpc_parser_t *p;
+  long pos;
+  int suppress;
+  int ok;
+  mpc_state_t end;
+  char last;
+  mpc_ast_t *output;
+  mpc_err_t *error;
+  mpc_err_t *merged;
+  size_t bytes;
+} mpc_memo_entry_t;
+
+typedef struct mpc_memo_t {
+  mpc_memo_entry_t *slots;
+  unsigned long cap;
+  unsigned long num;
+  size_t bytes;
+} mpc_memo_t;
+
+enum {
+  MPC_MEMO_MIN = 256
+};
+
+static size_t mpc_memo_budget = 16 * 1024 * 1024;
+
+size_t mpc_memo_set_budget(size_t bytes) {
+  size_t prev = mpc_memo_budget;
+  mpc_memo_budget = bytes;
+  return prev;
+}
+
+static mpc_ast_t *mpc_ast_copy(mpc_ast_t *a, int arena, size_t *bytes);
+static int mpc_parse_node(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e);
+
+static unsigned long mpc_memo_hash(mpc_parser_t *p, long pos, int suppress) {
+  unsigned long h = ((unsigned long)(size_t)p >> 4) * 2654435761ul;
+  h += (unsigned long)pos * 40503ul + (unsigned long)suppress;
+  return h ^ (h >> 15);
+}
+
+static size_t mpc_memo_err_bytes(mpc_err_t *x) {
+  int j;
+  size_t n;
+  if (x == NULL) { return 0; }
+  n = sizeof(mpc_err_t) + strlen(x->filename) + 1 + sizeof(char*) * x->expected_num;
+  if (x->failure) { n += strlen(x->failure) + 1; }
+  for (j = 0; j < x->expected_num; j++) { n += strlen(x->expected[j]) + 1; }
+  return n;
+}
+
+static void mpc_memo_entry_delete(mpc_input_t *i, mpc_memo_entry_t *x) {
+  mpc_ast_delete(x->output);
+  mpc_err_delete_internal(i, x->error);
+  mpc_err_delete_internal(i, x->merged);
+  x->p = NULL;
+}
+
+static mpc_memo_entry_t *mpc_memo_find(mpc_memo_t *m, mpc_parser_t *p, long pos, int suppress) {
+  
+  unsigned long k;
+  
+  if (m == NULL || m->num == 0) { return NULL; }
+  
+  k = mpc_memo_hash(p, pos, suppress) & (m->cap - 1);
+  while (m->slots[k].p) {
+    mpc_memo_entry_t *x = &m->slots[k];
+    if (x->p == p && x->pos == pos && x->suppress == suppress) { return x; }
+    k = (k + 1) & (m->cap - 1);
+  }
+  return NULL;
+}
+
+/* Move the entries at or after 'low' into a table of 'cap' slots, dropping the rest */
+static void mpc_memo_rehash(mpc_input_t *i, mpc_memo_t *m, unsigned long cap, long low) {
+  
+  mpc_memo_entry_t *slots = calloc(cap, sizeof(mpc_memo_entry_t));
+  unsigned long j, k;
+  
+  m->num = 0;
+  m->bytes = 0;
+  for (j = 0; j < m->cap; j++) {
+    mpc_memo_entry_t *x = &m->slots[j];
+    if (x->p == NULL) { continue; }
+    if (x->pos < low) {
+      x->p->memo_evicted++;
+      mpc_memo_entry_delete(i, x);
+      continue;
+    }
+    k = mpc_memo_hash(x->p, x->pos, x->suppress) & (cap - 1);
+    while (slots[k].p) { k = (k + 1) & (cap - 1); }
+    slots[k] = *x;
+    m->num++;
+    m->bytes += x->bytes;
+  }
+  
+  free(m->slots);
+  m->slots = slots;
+  m->cap = cap;
+}
+
+/* Drop every entry, counting them as evicted if that is for the budget */
+static void mpc_memo_clear(mpc_input_t *i, mpc_memo_t *m, int evict) {
+  unsigned long j;
+  for (j = 0; j < m->cap; j++) {
+    if (m->slots[j].p == NULL) { continue; }
+    if (evict) { m->slots[j].p->memo_evicted++; }
+    mpc_memo_entry_delete(i, &m->slots[j]);
+  }
+  m->num = 0;
+  m->bytes = 0;
+}
+
+static void mpc_memo_delete(mpc_input_t *i) {
+  if (i->memo == NULL) { return; }
+  mpc_memo_clear(i, i->memo, 0);
+  free(i->memo->slots);
+  free(i->memo);
+}
+
+/* Remember that 'p', started at 'pos', returned 'x' and 'r' having merged 'd' */
+static void mpc_memo_add(mpc_input_t *i, mpc_parser_t *p, long pos, int x, mpc_result_t *r, mpc_err_t *d) {
+  
+  mpc_memo_t *m = i->memo;
+  mpc_memo_entry_t y;
+  unsigned long k;
+  
+  /* Two slots an entry, as the table is kept at most half full */
+  y.p = p;
+  y.pos = pos;
+  y.suppress = i->suppress > 0;
+  y.ok = x;
+  y.end = i->state;
+  y.last = i->last;
+  y.bytes = 2 * sizeof(mpc_memo_entry_t);
+  y.output = x ? mpc_ast_copy(r->output, 0, &y.bytes) : NULL;
+  y.error = x || r->error == NULL ? NULL : mpc_err_export(i, mpc_err_copy(i, r->error));
+  y.merged = d ? mpc_err_export(i, mpc_err_copy(i, d)) : NULL;
+  y.bytes += mpc_memo_err_bytes(y.error) + mpc_memo_err_bytes(y.merged);
+  
+  if (y.bytes > mpc_memo_budget) { mpc_memo_entry_delete(i, &y); return; }
+  
+  if (m == NULL) { m = i->memo = calloc(1, sizeof(mpc_memo_t)); }
+  
+  if (m->bytes + y.bytes > mpc_memo_budget) {
+    mpc_memo_rehash(i, m, m->cap, i->marks_num ? i->marks[0].pos : i->state.pos);
+  }
+  if (m->bytes + y.bytes > mpc_memo_budget) { mpc_memo_clear(i, m, 1); }
+  
+  if ((m->num + 1) * 2 > m->cap) {
+    mpc_memo_rehash(i, m, m->cap ? m->cap * 2 : MPC_MEMO_MIN, 0);
+  }
+  
+  k = mpc_memo_hash(p, pos, y.suppress) & (m->cap - 1);
+  while (m->slots[k].p) { k = (k + 1) & (m->cap - 1); }
+  m->slots[k] = y;
+  m->num++;
+  m->bytes += y.bytes;
+}
+
+static int mpc_parse_memo(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e) {
+  
+  long pos = i->state.pos;
+  mpc_memo_entry_t *m = mpc_memo_find(i->memo, p, pos, i->suppress > 0);
+  mpc_err_t *d = NULL;
+  int x;
+  
+  p->memo_lookups++;
+  
+  if (m) {
+    p->memo_hits++;
+    i->state = m->end;
+    i->last = m->last;
+    if (m->merged) { *e = mpc_err_merge(i, *e, mpc_err_copy(i, m->merged)); }
+    if (m->ok) {
+      r->output = mpc_ast_copy(m->output, 1, NULL);
+    } else {
+      r->error = mpc_err_copy(i, m->error);
+    }
+    return m->ok;
+  }
+  
+  x = mpc_parse_node(i, p, r, &d);
+  mpc_memo_add(i, p, pos, x, r, d);
+  if (d) { *e = mpc_err_merge(i, *e, d); }
+  return x;
+}
+
 static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e) {
+  /* Without backtracking nothing is tried twice */
+  if (p->memo && i->backtrack > 0) { return mpc_parse_memo(i, p, r, e); }
+  return mpc_parse_node(i, p, r, e);
+}
+
+static int mpc_parse_node(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_err_t **e) {
   
   int j = 0, k = 0;
   mpc_result_t results_stk[MPC_PARSE_STACK_MIN];
   mpc_result_t *results;
   int results_slots = MPC_PARSE_STACK_MIN;
+  mpc_or_table_t *t = NULL;
+  unsigned char c = 0;
   
   switch (p->type) {
       
@@ -1020,8 +1859,8 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
     case MPC_TYPE_ANY:     MPC_PRIMITIVE(mpc_input_any(i, (char**)&r->output));
     case MPC_TYPE_SINGLE:  MPC_PRIMITIVE(mpc_input_char(i, p->data.single.x, (char**)&r->output));
     case MPC_TYPE_RANGE:   MPC_PRIMITIVE(mpc_input_range(i, p->data.range.x, p->data.range.y, (char**)&r->output));
-    case MPC_TYPE_ONEOF:   MPC_PRIMITIVE(mpc_input_oneof(i, p->data.string.x, (char**)&r->output));
-    case MPC_TYPE_NONEOF:  MPC_PRIMITIVE(mpc_input_noneof(i, p->data.string.x, (char**)&r->output));
+    case MPC_TYPE_ONEOF:   MPC_PRIMITIVE(mpc_input_class(i, p->data.string.bits, (char**)&r->output));
+    case MPC_TYPE_NONEOF:  MPC_PRIMITIVE(mpc_input_class(i, p->data.string.bits, (char**)&r->output));
     case MPC_TYPE_SATISFY: MPC_PRIMITIVE(mpc_input_satisfy(i, p->data.satisfy.f, (char**)&r->output));
     case MPC_TYPE_STRING:  MPC_PRIMITIVE(mpc_input_string(i, p->data.string.x, (char**)&r->output));
     case MPC_TYPE_ANCHOR:  MPC_PRIMITIVE(mpc_input_anchor(i, p->data.anchor.f, (char**)&r->output));
@@ -1034,6 +1873,7 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
     case MPC_TYPE_LIFT:      MPC_SUCCESS(p->data.lift.lf());
     case MPC_TYPE_LIFT_VAL:  MPC_SUCCESS(p->data.lift.x);
     case MPC_TYPE_STATE:     MPC_SUCCESS(mpc_input_state_copy(i));
+    case MPC_TYPE_DFA:       return mpc_parse_dfa(i, p->data.dfa.d, p->data.dfa.x, r, e);
     
     /* Application Parsers */
     
@@ -1101,6 +1941,8 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
     
     case MPC_TYPE_MANY:
       
+      if (mpc_parse_run_span(i, p, r, e)) { return 1; }
+      
       results = results_stk;
       
       while (mpc_parse_run(i, p->data.repeat.x, &results[j], e)) {
@@ -1122,6 +1964,8 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
     
     case MPC_TYPE_MANY1:
       
+      if (mpc_parse_run_span(i, p, r, e)) { return 1; }
+      
       results = results_stk;
       
       while (mpc_parse_run(i, p->data.repeat.x, &results[j], e)) {
@@ -1153,16 +1997,19 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
         ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.repeat.n)
         : results_stk;
       
+      mpc_input_mark(i);
       while (mpc_parse_run(i, p->data.repeat.x, &results[j], e)) {
         j++;
         if (j == p->data.repeat.n) { break; }
       }
       
       if (j == p->data.repeat.n) {
+        mpc_input_unmark(i);
         MPC_SUCCESS(
           mpc_parse_fold(i, p->data.repeat.f, j, (mpc_val_t**)results);
           if (p->data.repeat.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
       } else {
+        mpc_input_rewind(i);
         for (k = 0; k < j; k++) {
           mpc_parse_dtor(i, p->data.repeat.dx, results[k].output);
         }
@@ -1181,12 +2028,29 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
         ? mpc_malloc(i, sizeof(mpc_result_t) * p->data.or.n)
         : results_stk;
       
-      for (j = 0; j < p->data.or.n; j++) {
-        if (mpc_parse_run(i, p->data.or.xs[j], &results[j], e)) {
+      if (p->data.or.n > 1) { t = mpc_or_table(p); }
+      
+      /* Go straight to the first that might match, reporting the rest together */
+      if (t) {
+        c = (unsigned char)mpc_input_peekc(i);
+        j = t->start[c];
+        if (j > 0 && !i->suppress && !mpc_parse_or_lead(i, t, j, e)) { j = 0; }
+      }
+      
+      for (; j < p->data.or.n; j++) {
+        if (t && !MPC_CLASS_HAS(t->viable + 32 * j, c)) {
+          if (i->suppress) { continue; }
+          k = mpc_parse_or_skip(i, &t->skips[j], p->data.or.xs[j], &results[j], e);
+        } else {
+          k = mpc_parse_run(i, p->data.or.xs[j], &results[j], e);
+        }
+        if (k) {
           MPC_SUCCESS(results[j].output;
             if (p->data.or.n > MPC_PARSE_STACK_MIN) { mpc_free(i, results); });
         } else {
           *e = mpc_err_merge(i, *e, results[j].error);
+          /* Without backtracking a failure may have left the input further on */
+          if (t && i->backtrack < 1) { c = (unsigned char)mpc_input_peekc(i); }
         } 
       }
       
@@ -1232,8 +2096,12 @@ static int mpc_parse_run(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r, mpc_e
 #undef MPC_FAILURE
 #undef MPC_PRIMITIVE
 
+static struct mpc_ast_arena_t *mpc_ast_arena_begin(mpc_parser_t *p);
+static void mpc_ast_arena_end(struct mpc_ast_arena_t *a, int x, mpc_result_t *r);
+
 int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
   int x;
+  struct mpc_ast_arena_t *a = mpc_ast_arena_begin(p);
   mpc_err_t *e = mpc_err_fail(i, "Unknown Error");
   e->state = mpc_state_invalid();
   x = mpc_parse_run(i, p, r, &e);
@@ -1243,6 +2111,7 @@ int mpc_parse_input(mpc_input_t *i, mpc_parser_t *p, mpc_result_t *r) {
   } else {
     r->error = mpc_err_export(i, mpc_err_merge(i, e, r->error));
   }
+  mpc_ast_arena_end(a, x, r);
   return x;
 }
 
@@ -1280,8 +2149,9 @@ int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result
 
 int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
   
-  FILE *f = fopen(filename, "rb");
+  mpc_input_t *i;
   int res;
+  FILE *f = fopen(filename, "rb");
   
   if (f == NULL) {
     r->output = NULL;
@@ -1289,7 +2159,13 @@ int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
     return 0;
   }
   
-  res = mpc_parse_file(filename, f, p, r);
+  i = mpc_input_new_mmap(filename, f);
+  if (i) {
+    res = mpc_parse_input(i, p, r);
+    mpc_input_delete(i);
+  } else {
+    res = mpc_parse_file(filename, f, p, r);
+  }
   fclose(f);
   return res;
 }
@@ -1299,6 +2175,7 @@ int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r) {
 */
 
 static void mpc_undefine_unretained(mpc_parser_t *p, int force);
+static void mpc_tags_delete(struct mpc_tags_t *t);
 
 static void mpc_undefine_or(mpc_parser_t *p) {
   
@@ -1307,6 +2184,7 @@ static void mpc_undefine_or(mpc_parser_t *p) {
     mpc_undefine_unretained(p->data.or.xs[i], 0);
   }
   free(p->data.or.xs);
+  mpc_or_table_delete(p->data.or.t, p->data.or.n);
   
 }
 
@@ -1358,10 +2236,16 @@ static void mpc_undefine_unretained(mpc_parser_t *p, int force) {
     case MPC_TYPE_OR:  mpc_undefine_or(p);  break;
     case MPC_TYPE_AND: mpc_undefine_and(p); break;
     
+    case MPC_TYPE_DFA:
+      mpc_undefine_unretained(p->data.dfa.x, 0);
+      mpc_dfa_delete(p->data.dfa.d);
+      break;
+    
     default: break;
   }
   
   if (!force) {
+    mpc_tags_delete(p->tags);
     free(p->name);
     free(p);
   }
@@ -1375,6 +2259,7 @@ void mpc_delete(mpc_parser_t *p) {
       mpc_undefine_unretained(p, 0);
     } 
     
+    mpc_tags_delete(p->tags);
     free(p->name);
     free(p);
   
@@ -1396,13 +2281,19 @@ static mpc_parser_t *mpc_undefined(void) {
 }
 
 mpc_parser_t *mpc_new(const char *name) {
+  static int ids = 0;
   mpc_parser_t *p = mpc_undefined();
   p->retained = 1;
+  p->id = ++ids;
   p->name = realloc(p->name, strlen(name) + 1);
   strcpy(p->name, name);
   return p;
 }
 
+int mpc_parser_id(mpc_parser_t *p) {
+  return p->id;
+}
+
 mpc_parser_t *mpc_copy(mpc_parser_t *a) {
   int i = 0;
   mpc_parser_t *p;
@@ -1412,7 +2303,9 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
   p = mpc_undefined();
   p->retained = a->retained;
   p->type = a->type;
+  p->id = a->id;
   p->data = a->data;
+  p->tags = NULL;
   
   if (a->name) {
     p->name = malloc(strlen(a->name)+1);
@@ -1459,6 +2352,7 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
       for (i = 0; i < a->data.or.n; i++) {
         p->data.or.xs[i] = mpc_copy(a->data.or.xs[i]);
       }
+      p->data.or.t = NULL;
     break;
     case MPC_TYPE_AND:
       p->data.and.xs = malloc(a->data.and.n * sizeof(mpc_parser_t*));
@@ -1470,6 +2364,10 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
         p->data.and.dxs[i] = a->data.and.dxs[i];
       }
     break;
+    case MPC_TYPE_DFA:
+      p->data.dfa.x = mpc_copy(a->data.dfa.x);
+      p->data.dfa.d = mpc_dfa_copy(a->data.dfa.d);
+    break;
     
     default: break;
   }
@@ -1479,6 +2377,7 @@ mpc_parser_t *mpc_copy(mpc_parser_t *a) {
 }
 
 mpc_parser_t *mpc_undefine(mpc_parser_t *p) {
+  mpc_or_gen++;
   mpc_undefine_unretained(p, 1);
   p->type = MPC_TYPE_UNDEFINED;
   return p;
@@ -1486,6 +2385,8 @@ mpc_parser_t *mpc_undefine(mpc_parser_t *p) {
 
 mpc_parser_t *mpc_define(mpc_parser_t *p, mpc_parser_t *a) {
   
+  mpc_or_gen++;
+  
   if (p->retained) {
     p->type = a->type;
     p->data = a->data;
@@ -1666,11 +2567,37 @@ mpc_parser_t *mpc_range(char s, char e) {
   return mpc_expectf(p, "character between '%c' and '%c'", s, e);
 }
 
+/* Fill in the bitmap and ranges of ONEOF or NONEOF 'p' from its string */
+static void mpc_class_build(mpc_parser_t *p) {
+  
+  mpc_pdata_string_t *d = &p->data.string;
+  int c, in, n = 0;
+  
+  memset(d->bits, 0, sizeof(d->bits));
+  for (c = 0; c < 256; c++) {
+    /* The string's terminator is never in it */
+    in = c && strchr(d->x, c);
+    if (p->type == MPC_TYPE_NONEOF) { in = !in; }
+    if (in) { d->bits[c >> 3] |= (unsigned char)(1 << (c & 7)); }
+  }
+  
+  for (c = 0; c < 256; c++) {
+    if (!MPC_CLASS_HAS(d->bits, c)) { continue; }
+    if (n == MPC_CLASS_RANGES_MAX) { n = 0; break; }
+    d->ranges[2*n] = (unsigned char)c;
+    while (c < 255 && MPC_CLASS_HAS(d->bits, c + 1)) { c++; }
+    d->ranges[2*n+1] = (unsigned char)c;
+    n++;
+  }
+  d->ranges_num = (unsigned char)n;
+}
+
 mpc_parser_t *mpc_oneof(const char *s) {
   mpc_parser_t *p = mpc_undefined();
   p->type = MPC_TYPE_ONEOF;
   p->data.string.x = malloc(strlen(s) + 1);
   strcpy(p->data.string.x, s);
+  mpc_class_build(p);
   return mpc_expectf(p, "one of '%s'", s);
 }
 
@@ -1679,6 +2606,7 @@ mpc_parser_t *mpc_noneof(const char *s) {
   p->type = MPC_TYPE_NONEOF;
   p->data.string.x = malloc(strlen(s) + 1);
   strcpy(p->data.string.x, s);
+  mpc_class_build(p);
   return mpc_expectf(p, "none of '%s'", s);
 
 }
@@ -2123,37 +3051,393 @@ static mpc_val_t *mpcf_re_range(mpc_val_t *x) {
       i++;
     }
     
-    /* Regex Range...Range */
-    else if (s[i] == '-') {
-      if (s[i+1] == '\0' || i == 0) {
-          range = realloc(range, strlen(range) + strlen("-") + 1);
-          strcat(range, "-");
-      } else {
-        start = s[i-1]+1;
-        end = s[i+1]-1;
-        for (j = start; j <= end; j++) {
-          range = realloc(range, strlen(range) + 1 + 1 + 1);
-          range[strlen(range) + 1] = '\0';
-          range[strlen(range) + 0] = (char)j;
-        }        
+    /* Regex Range...Range */
+    else if (s[i] == '-') {
+      if (s[i+1] == '\0' || i == 0) {
+          range = realloc(range, strlen(range) + strlen("-") + 1);
+          strcat(range, "-");
+      } else {
+        start = s[i-1]+1;
+        end = s[i+1]-1;
+        for (j = start; j <= end; j++) {
+          range = realloc(range, strlen(range) + 1 + 1 + 1);
+          range[strlen(range) + 1] = '\0';
+          range[strlen(range) + 0] = (char)j;
+        }        
+      }
+    }
+    
+    /* Regex Range Normal */
+    else {
+      range = realloc(range, strlen(range) + 1 + 1);
+      range[strlen(range) + 1] = '\0';
+      range[strlen(range) + 0] = s[i];
+    }
+  
+  }
+  
+  out = comp == 1 ? mpc_noneof(range) : mpc_oneof(range);
+  
+  free(x);
+  free(range);
+  
+  return out;
+}
+
+/*
+** Once built, a regex is also compiled into an mpc_dfa_t if it can be.
+** Each character parser in it becomes a position, and the table is
+** worked out from which positions may follow which. This is only done
+** when the next character always decides which position is next, as
+** then the longest match is exactly what the combinators would find,
+** and the combinators are kept to fall back on for everything else.
+*/
+
+enum { MPC_DFA_POSITIONS_MAX = 254 };
+
+typedef struct {
+  unsigned char first[MPC_DFA_POSITIONS_MAX];
+  unsigned char last[MPC_DFA_POSITIONS_MAX];
+  int nullable;
+} mpc_dfa_frag_t;
+
+/*
+** The positions 'lo' to 'hi' of a many1 or count. A failed first go
+** at either has its error relabelled, which the table does not follow.
+*/
+typedef struct {
+  int lo, hi;
+  int count;
+} mpc_dfa_range_t;
+
+typedef struct {
+  int num;
+  unsigned char (*chars)[256];
+  const char **labels;
+  unsigned char *follow;
+  /* The many1 whose going round is the only reason for each follow */
+  int *loops;
+  /* When each was added, as inner parts are tried before outer ones */
+  int *added;
+  int added_num;
+  mpc_dfa_range_t *ranges;
+  int ranges_num;
+} mpc_dfa_build_t;
+
+/* Let position 'j' follow 'k', for many1 number 'loop' going round or 0 */
+static void mpc_dfa_follow(mpc_dfa_build_t *b, int k, int j, int loop) {
+  int e = k * MPC_DFA_POSITIONS_MAX + j;
+  if (!b->follow[e]) {
+    b->loops[e] = loop;
+    b->added[e] = b->added_num++;
+  } else if (b->loops[e] != loop) { b->loops[e] = 0; }
+  b->follow[e] = 1;
+}
+
+static int mpc_dfa_range(mpc_dfa_build_t *b, int lo, int count) {
+  b->ranges = realloc(b->ranges, sizeof(mpc_dfa_range_t) * (b->ranges_num + 1));
+  b->ranges[b->ranges_num].lo = lo;
+  b->ranges[b->ranges_num].hi = b->num;
+  b->ranges[b->ranges_num].count = count;
+  return ++b->ranges_num;
+}
+
+/* If reaching 'p' from position 's', or the start if -1, can be a first go */
+static int mpc_dfa_relabelled(mpc_dfa_build_t *b, int s, int p) {
+  int j;
+  for (j = 0; j < b->ranges_num; j++) {
+    if (p < b->ranges[j].lo || p >= b->ranges[j].hi) { continue; }
+    if (b->ranges[j].count || s < 0) { return 1; }
+    if (b->loops[s * MPC_DFA_POSITIONS_MAX + p] != j + 1) { return 1; }
+  }
+  return 0;
+}
+
+/* Add the characters 'p' matches to 'set', if it matches exactly one */
+static int mpc_dfa_chars(mpc_parser_t *p, unsigned char *set) {
+  
+  int j, c;
+  
+  switch (p->type) {
+    case MPC_TYPE_EXPECT: return mpc_dfa_chars(p->data.expect.x, set);
+    case MPC_TYPE_ANY: memset(set, 1, 256); return 1;
+    case MPC_TYPE_SINGLE: set[(unsigned char)p->data.single.x] = 1; return 1;
+    case MPC_TYPE_RANGE:
+      for (c = 0; c < 256; c++) {
+        if ((char)c >= p->data.range.x && (char)c <= p->data.range.y) { set[c] = 1; }
+      }
+      return 1;
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      for (c = 0; c < 256; c++) {
+        if (MPC_CLASS_HAS(p->data.string.bits, c)) { set[c] = 1; }
+      }
+      return 1;
+    case MPC_TYPE_OR:
+      if (p->data.or.n == 0) { return 0; }
+      for (j = 0; j < p->data.or.n; j++) {
+        if (!mpc_dfa_chars(p->data.or.xs[j], set)) { return 0; }
+      }
+      return 1;
+    default: return 0;
+  }
+}
+
+/* 'f' followed by 'g' */
+static void mpc_dfa_concat(mpc_dfa_build_t *b, mpc_dfa_frag_t *f, mpc_dfa_frag_t *g) {
+  int j, k;
+  for (k = 0; k < b->num; k++) {
+    if (!f->last[k]) { continue; }
+    for (j = 0; j < b->num; j++) {
+      if (g->first[j]) { mpc_dfa_follow(b, k, j, 0); }
+    }
+  }
+  for (j = 0; j < b->num; j++) {
+    if (f->nullable) { f->first[j] |= g->first[j]; }
+    f->last[j] = g->last[j] | (g->nullable ? f->last[j] : 0);
+  }
+  f->nullable = f->nullable && g->nullable;
+}
+
+static int mpc_dfa_frag(mpc_dfa_build_t *b, mpc_parser_t *p, mpc_dfa_frag_t *f) {
+  
+  mpc_dfa_frag_t g;
+  int j, k, loop;
+  
+  memset(f, 0, sizeof(mpc_dfa_frag_t));
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_EXPECT:
+      if (b->num == MPC_DFA_POSITIONS_MAX) { return 0; }
+      memset(b->chars[b->num], 0, 256);
+      if (!mpc_dfa_chars(p->data.expect.x, b->chars[b->num])) { return 0; }
+      b->labels[b->num] = p->data.expect.m;
+      f->first[b->num] = f->last[b->num] = 1;
+      b->num++;
+      return 1;
+    
+    case MPC_TYPE_LIFT:
+      f->nullable = 1;
+      return p->data.lift.lf == mpcf_ctor_str;
+    
+    case MPC_TYPE_AND:
+      if (p->data.and.f != mpcf_strfold) { return 0; }
+      f->nullable = 1;
+      for (j = 0; j < p->data.and.n; j++) {
+        if (!mpc_dfa_frag(b, p->data.and.xs[j], &g)) { return 0; }
+        mpc_dfa_concat(b, f, &g);
+      }
+      return 1;
+    
+    case MPC_TYPE_COUNT:
+      if (p->data.repeat.f != mpcf_strfold || p->data.repeat.n < 1) { return 0; }
+      f->nullable = 1;
+      k = b->num;
+      for (j = 0; j < p->data.repeat.n; j++) {
+        if (!mpc_dfa_frag(b, p->data.repeat.x, &g)) { return 0; }
+        mpc_dfa_concat(b, f, &g);
+      }
+      mpc_dfa_range(b, k, 1);
+      return 1;
+    
+    /* Ordered choice only agrees when nothing but the last can match empty */
+    case MPC_TYPE_OR:
+      if (p->data.or.n == 0) { return 0; }
+      for (j = 0; j < p->data.or.n; j++) {
+        if (!mpc_dfa_frag(b, p->data.or.xs[j], &g)) { return 0; }
+        if (g.nullable && j < p->data.or.n - 1) { return 0; }
+        for (k = 0; k < b->num; k++) {
+          f->first[k] |= g.first[k];
+          f->last[k] |= g.last[k];
+        }
+        f->nullable = g.nullable;
+      }
+      return 1;
+    
+    case MPC_TYPE_MAYBE:
+      if (p->data.not.lf != mpcf_ctor_str) { return 0; }
+      if (!mpc_dfa_frag(b, p->data.not.x, f)) { return 0; }
+      f->nullable = 1;
+      return 1;
+    
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+      if (p->data.repeat.f != mpcf_strfold) { return 0; }
+      k = b->num;
+      if (!mpc_dfa_frag(b, p->data.repeat.x, f) || f->nullable) { return 0; }
+      loop = p->type == MPC_TYPE_MANY1 ? mpc_dfa_range(b, k, 0) : 0;
+      for (k = 0; k < b->num; k++) {
+        if (!f->last[k]) { continue; }
+        for (j = 0; j < b->num; j++) {
+          if (f->first[j]) { mpc_dfa_follow(b, k, j, loop); }
+        }
+      }
+      f->nullable = p->type == MPC_TYPE_MANY;
+      return 1;
+    
+    default: return 0;
+  }
+  
+}
+
+/* If no two of the positions in 'set' share a character */
+static int mpc_dfa_disjoint(mpc_dfa_build_t *b, const unsigned char *set) {
+  unsigned char seen[256];
+  int j, c;
+  memset(seen, 0, 256);
+  for (j = 0; j < b->num; j++) {
+    if (!set[j]) { continue; }
+    for (c = 0; c < 256; c++) {
+      if (!b->chars[j][c]) { continue; }
+      if (seen[c]) { return 0; }
+      seen[c] = 1;
+    }
+  }
+  return 1;
+}
+
+/* If 'p' is the regex for anchor 'f', as built by '^', '$', '\A' or '\Z' */
+static int mpc_dfa_anchor(mpc_parser_t *p, int(*f)(char,char)) {
+  mpc_parser_t *a;
+  if (p->type != MPC_TYPE_AND || p->data.and.f != mpcf_snd || p->data.and.n != 2) { return 0; }
+  if (p->data.and.xs[1]->type != MPC_TYPE_LIFT) { return 0; }
+  a = p->data.and.xs[0];
+  while (a->type == MPC_TYPE_EXPECT) { a = a->data.expect.x; }
+  return a->type == MPC_TYPE_ANCHOR && a->data.anchor.f == f;
+}
+
+static mpc_dfa_t *mpc_dfa_tables(mpc_dfa_build_t *b, mpc_dfa_frag_t *root) {
+  
+  mpc_dfa_t *d = calloc(1, sizeof(mpc_dfa_t));
+  const unsigned char *set;
+  int *order = malloc(sizeof(int) * b->num);
+  int s, j, k, c, o, m, n = 0;
+  
+  d->states = b->num + 2;
+  d->next = calloc(d->states * 256, 1);
+  d->accept = calloc(d->states, 1);
+  d->exact = calloc(d->states, 1);
+  d->expected_start = calloc(d->states + 1, sizeof(int));
+  d->expected = malloc(sizeof(int) * d->states * b->num);
+  d->names = malloc(sizeof(char*) * b->num);
+  
+  d->accept[1] = root->nullable;
+  for (j = 0; j < b->num; j++) { d->accept[j+2] = root->last[j]; }
+  
+  for (s = 1; s < d->states; s++) {
+    
+    d->expected_start[s] = n;
+    d->exact[s] = 1;
+    set = s == 1 ? root->first : b->follow + (s - 2) * MPC_DFA_POSITIONS_MAX;
+    
+    /* In the order the combinators would try them */
+    for (j = 0, m = 0; j < b->num; j++) {
+      if (!set[j]) { continue; }
+      for (o = m++; o > 0 && s > 1
+        && b->added[(s - 2) * MPC_DFA_POSITIONS_MAX + order[o-1]]
+         > b->added[(s - 2) * MPC_DFA_POSITIONS_MAX + j]; o--) {
+        order[o] = order[o-1];
       }
+      order[o] = j;
     }
     
-    /* Regex Range Normal */
-    else {
-      range = realloc(range, strlen(range) + 1 + 1);
-      range[strlen(range) + 1] = '\0';
-      range[strlen(range) + 0] = s[i];
+    for (o = 0; o < m; o++) {
+      j = order[o];
+      
+      if (mpc_dfa_relabelled(b, s - 2, j)) { d->exact[s] = 0; }
+      
+      for (c = 0; c < 256; c++) {
+        if (b->chars[j][c]) { d->next[s * 256 + c] = (unsigned char)(j + 2); }
+      }
+      
+      /* Each name once, in the order the regex gives them */
+      for (k = 0; k < d->names_num; k++) {
+        if (strcmp(d->names[k], b->labels[j]) == 0) { break; }
+      }
+      if (k == d->names_num) {
+        d->names[k] = malloc(strlen(b->labels[j]) + 1);
+        strcpy(d->names[k], b->labels[j]);
+        d->names_num++;
+      }
+      for (c = d->expected_start[s]; c < n; c++) {
+        if (d->expected[c] == k) { break; }
+      }
+      if (c == n) { d->expected[n++] = k; }
     }
+  }
+  d->expected_start[d->states] = n;
+  
+  free(order);
+  return d;
+}
+
+/* Wrap regex 'p' with its compiled table, or return it as it is; never with -DMPC_NO_DFA */
+static mpc_parser_t *mpc_re_dfa(mpc_parser_t *p) {
+  
+  mpc_dfa_build_t b;
+  mpc_dfa_frag_t root, g;
+  mpc_parser_t **xs = &p;
+  mpc_parser_t *q;
+  int(*soi)(char,char) = NULL;
+  int(*eoi)(char,char) = NULL;
+  int j, n = 1, from = 0, ok = 1;
+  
+#ifdef MPC_NO_DFA
+  return p;
+#endif
   
+  if (p->type == MPC_TYPE_AND && p->data.and.f == mpcf_strfold) {
+    xs = p->data.and.xs;
+    n = p->data.and.n;
   }
   
-  out = comp == 1 ? mpc_noneof(range) : mpc_oneof(range);
+  /* Anchors are checked either side of the table, not in it */
+  while (from < n && xs[from]->type == MPC_TYPE_LIFT) { from++; }
+  if (from < n && mpc_dfa_anchor(xs[from], mpc_soi_anchor)) { soi = mpc_soi_anchor; }
+  if (n > 0 && mpc_dfa_anchor(xs[n-1], mpc_eoi_anchor)) { eoi = mpc_eoi_anchor; n--; }
+  
+  b.num = 0;
+  b.chars = malloc(256 * MPC_DFA_POSITIONS_MAX);
+  b.labels = malloc(sizeof(char*) * MPC_DFA_POSITIONS_MAX);
+  b.follow = calloc(MPC_DFA_POSITIONS_MAX, MPC_DFA_POSITIONS_MAX);
+  b.loops = malloc(sizeof(int) * MPC_DFA_POSITIONS_MAX * MPC_DFA_POSITIONS_MAX);
+  b.added = malloc(sizeof(int) * MPC_DFA_POSITIONS_MAX * MPC_DFA_POSITIONS_MAX);
+  b.added_num = 0;
+  b.ranges = NULL;
+  b.ranges_num = 0;
+  
+  memset(&root, 0, sizeof(mpc_dfa_frag_t));
+  root.nullable = 1;
+  for (j = 0; j < n && ok; j++) {
+    if (j == from && soi) { continue; }
+    ok = mpc_dfa_frag(&b, xs[j], &g);
+    if (ok) { mpc_dfa_concat(&b, &root, &g); }
+  }
   
-  free(x);
-  free(range);
+  ok = ok && b.num > 0 && mpc_dfa_disjoint(&b, root.first);
+  for (j = 0; j < b.num && ok; j++) {
+    ok = mpc_dfa_disjoint(&b, b.follow + j * MPC_DFA_POSITIONS_MAX);
+  }
   
-  return out;
+  if (ok) {
+    q = mpc_undefined();
+    q->type = MPC_TYPE_DFA;
+    q->data.dfa.x = p;
+    q->data.dfa.d = mpc_dfa_tables(&b, &root);
+    q->data.dfa.d->soi = soi;
+    q->data.dfa.d->eoi = eoi;
+    p = q;
+  }
+  
+  free(b.chars);
+  free(b.labels);
+  free(b.follow);
+  free(b.loops);
+  free(b.added);
+  free(b.ranges);
+  
+  return p;
 }
 
 mpc_parser_t *mpc_re(const char *re) {
@@ -2219,7 +3503,7 @@ mpc_parser_t *mpc_re(const char *re) {
   
   mpc_optimise(r.output);
   
-  return r.output;
+  return mpc_re_dfa(r.output);
   
 }
 
@@ -2442,16 +3726,21 @@ mpc_val_t *mpcf_trd_free(int n, mpc_val_t **xs) { return mpcf_nth_free(n, xs, 2)
 
 mpc_val_t *mpcf_strfold(int n, mpc_val_t **xs) {
   int i;
-  size_t l = 0;
+  size_t l = 0, m;
   
   if (n == 0) { return calloc(1, 1); }
   
   for (i = 0; i < n; i++) { l += strlen(xs[i]); }
   
+  m = strlen(xs[0]);
   xs[0] = realloc(xs[0], l + 1);
   
+  /* Append at the end found so far rather than searching for it */
   for (i = 1; i < n; i++) {
-    strcat(xs[0], xs[i]); free(xs[i]);
+    size_t li = strlen(xs[i]);
+    memcpy((char*)xs[0] + m, xs[i], li + 1);
+    m += li;
+    free(xs[i]);
   }
   
   return xs[0];
@@ -2568,6 +3857,8 @@ static void mpc_print_unretained(mpc_parser_t *p, int force) {
   if (p->type == MPC_TYPE_MANY1) { mpc_print_unretained(p->data.repeat.x, 0); printf("+"); }
   if (p->type == MPC_TYPE_COUNT) { mpc_print_unretained(p->data.repeat.x, 0); printf("{%i}", p->data.repeat.n); }
   
+  if (p->type == MPC_TYPE_DFA) { mpc_print_unretained(p->data.dfa.x, 0); }
+  
   if (p->type == MPC_TYPE_OR) {
     printf("(");
     for(i = 0; i < p->data.or.n-1; i++) {
@@ -2661,6 +3952,179 @@ int mpc_test_pass(mpc_parser_t *p, const char *s, const void *d,
 }
 
 
+/*
+** AST Arena
+**
+** Tags are interned in an open addressing table hung off the parser
+** a parse started from, so each distinct tag is allocated once for
+** the life of the grammar. Everything else goes in blocks that only
+** ever grow, released together with the root.
+*/
+
+typedef struct mpc_tags_t {
+  char **slots;
+  unsigned long num;
+  unsigned long cap;
+} mpc_tags_t;
+
+typedef struct mpc_ast_block_t {
+  struct mpc_ast_block_t *next;
+  char *ptr;
+  char *end;
+} mpc_ast_block_t;
+
+typedef struct mpc_ast_arena_t {
+  mpc_ast_block_t *blocks;
+  unsigned long next_size;
+  mpc_tags_t *tags;
+  mpc_ast_t *root;
+  struct mpc_ast_arena_t *outer;
+} mpc_ast_arena_t;
+
+enum {
+  MPC_TAGS_MIN       = 64,
+  MPC_AST_BLOCK_MIN  = 4096,
+  MPC_AST_BLOCK_MAX  = 1 << 20
+};
+
+static int mpc_ast_arena_on = 0;
+static mpc_ast_arena_t *mpc_ast_arena_curr = NULL;
+
+int mpc_ast_arena_set(int on) {
+  int prev = mpc_ast_arena_on;
+  mpc_ast_arena_on = on;
+  return prev;
+}
+
+/* FNV-1a over the three pieces 'x', 'y' and 'z' in turn */
+static unsigned long mpc_tags_hash(const char *x, size_t nx, const char *y, size_t ny, const char *z) {
+  unsigned long h = 2166136261ul;
+  size_t j;
+  for (j = 0; j < nx; j++) { h = (h ^ (unsigned char)x[j]) * 16777619ul; }
+  for (j = 0; j < ny; j++) { h = (h ^ (unsigned char)y[j]) * 16777619ul; }
+  for (; *z; z++) { h = (h ^ (unsigned char)*z) * 16777619ul; }
+  return h;
+}
+
+static int mpc_tags_match(const char *s, const char *x, size_t nx, const char *y, size_t ny, const char *z) {
+  return strncmp(s, x, nx) == 0
+      && strncmp(s + nx, y, ny) == 0
+      && strcmp(s + nx + ny, z) == 0;
+}
+
+static void mpc_tags_grow(mpc_tags_t *t) {
+  unsigned long j, k, cap = t->cap ? t->cap * 2 : MPC_TAGS_MIN;
+  char **slots = calloc(cap, sizeof(char*));
+  for (j = 0; j < t->cap; j++) {
+    if (t->slots[j] == NULL) { continue; }
+    k = mpc_tags_hash("", 0, "", 0, t->slots[j]) & (cap - 1);
+    while (slots[k]) { k = (k + 1) & (cap - 1); }
+    slots[k] = t->slots[j];
+  }
+  free(t->slots);
+  t->slots = slots;
+  t->cap = cap;
+}
+
+/* The one copy of the first 'nx' of 'x', the first 'ny' of 'y', then 'z' */
+static char *mpc_tags_intern(mpc_tags_t *t, const char *x, size_t nx, const char *y, size_t ny, const char *z) {
+  
+  unsigned long k;
+  size_t nz;
+  char *s;
+  
+  if ((t->num + 1) * 2 > t->cap) { mpc_tags_grow(t); }
+  
+  k = mpc_tags_hash(x, nx, y, ny, z) & (t->cap - 1);
+  while (t->slots[k]) {
+    if (mpc_tags_match(t->slots[k], x, nx, y, ny, z)) { return t->slots[k]; }
+    k = (k + 1) & (t->cap - 1);
+  }
+  
+  nz = strlen(z);
+  s = malloc(nx + ny + nz + 1);
+  memcpy(s, x, nx);
+  memcpy(s + nx, y, ny);
+  memcpy(s + nx + ny, z, nz + 1);
+  t->slots[k] = s;
+  t->num++;
+  return s;
+}
+
+static void mpc_tags_delete(mpc_tags_t *t) {
+  unsigned long j;
+  if (t == NULL) { return; }
+  for (j = 0; j < t->cap; j++) { free(t->slots[j]); }
+  free(t->slots);
+  free(t);
+}
+
+static void *mpc_ast_arena_alloc(mpc_ast_arena_t *a, size_t n) {
+  
+  mpc_ast_block_t *b = a->blocks;
+  size_t size;
+  void *p;
+  
+  n = (n + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  
+  if (b == NULL || (size_t)(b->end - b->ptr) < n) {
+    size = n > a->next_size ? n : a->next_size;
+    if (a->next_size < MPC_AST_BLOCK_MAX) { a->next_size *= 2; }
+    b = malloc(sizeof(mpc_ast_block_t) + size);
+    b->ptr = (char*)(b + 1);
+    b->end = b->ptr + size;
+    b->next = a->blocks;
+    a->blocks = b;
+  }
+  
+  p = b->ptr;
+  b->ptr += n;
+  return p;
+}
+
+static void mpc_ast_arena_release(mpc_ast_arena_t *a) {
+  mpc_ast_block_t *b = a->blocks;
+  while (b) {
+    mpc_ast_block_t *n = b->next;
+    free(b);
+    b = n;
+  }
+  free(a);
+}
+
+/* Make the arena ASTs built while parsing with 'p' go to, if arena mode is on */
+static mpc_ast_arena_t *mpc_ast_arena_begin(mpc_parser_t *p) {
+  
+  mpc_ast_arena_t *a;
+  
+  if (!mpc_ast_arena_on) { return NULL; }
+  
+  if (p->tags == NULL) { p->tags = calloc(1, sizeof(mpc_tags_t)); }
+  
+  a = malloc(sizeof(mpc_ast_arena_t));
+  a->blocks = NULL;
+  a->next_size = MPC_AST_BLOCK_MIN;
+  a->tags = p->tags;
+  a->root = NULL;
+  a->outer = mpc_ast_arena_curr;
+  mpc_ast_arena_curr = a;
+  return a;
+}
+
+/* Hand the arena to the result, or release it if nothing was kept */
+static void mpc_ast_arena_end(mpc_ast_arena_t *a, int x, mpc_result_t *r) {
+  
+  if (a == NULL) { return; }
+  
+  mpc_ast_arena_curr = a->outer;
+  
+  if (x && r->output && a->blocks) {
+    a->root = r->output;
+  } else {
+    mpc_ast_arena_release(a);
+  }
+}
+
 /*
 ** AST
 */
@@ -2671,6 +4135,11 @@ void mpc_ast_delete(mpc_ast_t *a) {
   
   if (a == NULL) { return; }
   
+  if (a->arena) {
+    if (a->arena->root == a) { mpc_ast_arena_release(a->arena); }
+    return;
+  }
+  
   for (i = 0; i < a->children_num; i++) {
     mpc_ast_delete(a->children[i]);
   }
@@ -2683,6 +4152,7 @@ void mpc_ast_delete(mpc_ast_t *a) {
 }
 
 static void mpc_ast_delete_no_children(mpc_ast_t *a) {
+  if (a->arena) { return; }
   free(a->children);
   free(a->tag);
   free(a->contents);
@@ -2691,22 +4161,59 @@ static void mpc_ast_delete_no_children(mpc_ast_t *a) {
 
 mpc_ast_t *mpc_ast_new(const char *tag, const char *contents) {
   
-  mpc_ast_t *a = malloc(sizeof(mpc_ast_t));
+  mpc_ast_arena_t *arena = mpc_ast_arena_curr;
+  mpc_ast_t *a;
   
-  a->tag = malloc(strlen(tag) + 1);
-  strcpy(a->tag, tag);
-  
-  a->contents = malloc(strlen(contents) + 1);
-  strcpy(a->contents, contents);
+  if (arena) {
+    a = mpc_ast_arena_alloc(arena, sizeof(mpc_ast_t));
+    a->tag = mpc_tags_intern(arena->tags, "", 0, "", 0, tag);
+    a->contents = mpc_ast_arena_alloc(arena, strlen(contents) + 1);
+    strcpy(a->contents, contents);
+  } else {
+    a = malloc(sizeof(mpc_ast_t));
+    a->tag = malloc(strlen(tag) + 1);
+    strcpy(a->tag, tag);
+    a->contents = malloc(strlen(contents) + 1);
+    strcpy(a->contents, contents);
+  }
   
+  a->arena = arena;
   a->state = mpc_state_new();
   
   a->children_num = 0;
   a->children = NULL;
+  a->rule = 0;
+  a->kind = MPC_AST_OTHER;
   return a;
   
 }
 
+/* A deep copy of 'a', in the current arena only if 'arena' is set; adds its size to 'bytes' */
+static mpc_ast_t *mpc_ast_copy(mpc_ast_t *a, int arena, size_t *bytes) {
+  
+  mpc_ast_arena_t *curr = mpc_ast_arena_curr;
+  mpc_ast_t *c;
+  int j;
+  
+  if (a == NULL) { return NULL; }
+  
+  if (!arena) { mpc_ast_arena_curr = NULL; }
+  c = mpc_ast_new(a->tag, a->contents);
+  c->state = a->state;
+  c->rule = a->rule;
+  c->kind = a->kind;
+  for (j = 0; j < a->children_num; j++) {
+    mpc_ast_add_child(c, mpc_ast_copy(a->children[j], arena, bytes));
+  }
+  mpc_ast_arena_curr = curr;
+  
+  if (bytes) {
+    *bytes += sizeof(mpc_ast_t) + strlen(a->tag) + strlen(a->contents) + 2
+      + sizeof(mpc_ast_t*) * a->children_num;
+  }
+  return c;
+}
+
 mpc_ast_t *mpc_ast_build(int n, const char *tag, ...) {
   
   mpc_ast_t *a = mpc_ast_new(tag, "");
@@ -2734,6 +4241,7 @@ mpc_ast_t *mpc_ast_add_root(mpc_ast_t *a) {
   if (a->children_num == 1) { return a; }
 
   r = mpc_ast_new(">", "");
+  r->kind = MPC_AST_NODE;
   mpc_ast_add_child(r, a);
   return r;
 }
@@ -2754,14 +4262,32 @@ int mpc_ast_eq(mpc_ast_t *a, mpc_ast_t *b) {
 }
 
 mpc_ast_t *mpc_ast_add_child(mpc_ast_t *r, mpc_ast_t *a) {
-  r->children_num++;
-  r->children = realloc(r->children, sizeof(mpc_ast_t*) * r->children_num);
-  r->children[r->children_num-1] = a;
+  
+  int n = r->children_num;
+  mpc_ast_t **children;
+  
+  /* Capacity doubles from 4, so it follows from the count alone */
+  if (n == 0 || (n >= 4 && (n & (n - 1)) == 0)) {
+    size_t size = sizeof(mpc_ast_t*) * (n ? n * 2 : 4);
+    if (r->arena) {
+      children = mpc_ast_arena_alloc(r->arena, size);
+      if (n) { memcpy(children, r->children, sizeof(mpc_ast_t*) * n); }
+      r->children = children;
+    } else {
+      r->children = realloc(r->children, size);
+    }
+  }
+  
+  r->children[r->children_num++] = a;
   return r;
 }
 
 mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t) {
   if (a == NULL) { return a; }
+  if (a->arena) {
+    a->tag = mpc_tags_intern(a->arena->tags, t, strlen(t), "|", 1, a->tag);
+    return a;
+  }
   a->tag = realloc(a->tag, strlen(t) + 1 + strlen(a->tag) + 1);
   memmove(a->tag + strlen(t) + 1, a->tag, strlen(a->tag)+1);
   memmove(a->tag, t, strlen(t));
@@ -2771,13 +4297,43 @@ mpc_ast_t *mpc_ast_add_tag(mpc_ast_t *a, const char *t) {
 
 mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t) {
   if (a == NULL) { return a; }
+  if (a->arena) {
+    a->tag = mpc_tags_intern(a->arena->tags, t, strlen(t)-1, "", 0, a->tag);
+    return a;
+  }
   a->tag = realloc(a->tag, (strlen(t)-1) + strlen(a->tag) + 1);
   memmove(a->tag + (strlen(t)-1), a->tag, strlen(a->tag)+1);
   memmove(a->tag, t, (strlen(t)-1));
   return a;
 }
 
+/* Tag 'a' with the name of 'p', and its id unless a rule inside set one */
+static mpc_ast_t *mpc_ast_add_rule(mpc_ast_t *a, mpc_parser_t *p) {
+  if (a == NULL) { return a; }
+  if (a->rule == 0) { a->rule = p->id; }
+  return mpc_ast_add_tag(a, p->name);
+}
+
+static mpc_ast_t *mpc_ast_tag_string(mpc_ast_t *a, const char *t) {
+  a->kind = MPC_AST_STRING;
+  return mpc_ast_tag(a, t);
+}
+
+static mpc_ast_t *mpc_ast_tag_char(mpc_ast_t *a, const char *t) {
+  a->kind = MPC_AST_CHAR;
+  return mpc_ast_tag(a, t);
+}
+
+static mpc_ast_t *mpc_ast_tag_regex(mpc_ast_t *a, const char *t) {
+  a->kind = MPC_AST_REGEX;
+  return mpc_ast_tag(a, t);
+}
+
 mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t) {
+  if (a->arena) {
+    a->tag = mpc_tags_intern(a->arena->tags, "", 0, "", 0, t);
+    return a;
+  }
   a->tag = realloc(a->tag, strlen(t) + 1);
   strcpy(a->tag, t);
   return a;
@@ -2855,6 +4411,23 @@ mpc_ast_t *mpc_ast_get_child_lb(mpc_ast_t *ast, const char *tag, int lb) {
   return NULL;
 }
 
+int mpc_ast_get_index_rule(mpc_ast_t *ast, int rule, int lb) {
+  int i;
+
+  for(i=lb; i<ast->children_num; i++) {
+    if(ast->children[i]->rule == rule) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+mpc_ast_t *mpc_ast_get_child_rule(mpc_ast_t *ast, int rule, int lb) {
+  int i = mpc_ast_get_index_rule(ast, rule, lb);
+  return i < 0 ? NULL : ast->children[i];
+}
+
 mpc_ast_trav_t *mpc_ast_traverse_start(mpc_ast_t *ast,
                                        mpc_ast_trav_order_t order)
 {
@@ -3003,6 +4576,7 @@ mpc_val_t *mpcf_fold_ast(int n, mpc_val_t **xs) {
   if (n == 2 && xs[0] == NULL) { return xs[1]; }
   
   r = mpc_ast_new(">", "");
+  r->kind = MPC_AST_NODE;
   
   for (i = 0; i < n; i++) {
     
@@ -3056,6 +4630,10 @@ mpc_parser_t *mpca_add_tag(mpc_parser_t *a, const char *t) {
   return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_add_tag, (void*)t);
 }
 
+mpc_parser_t *mpca_add_rule(mpc_parser_t *a, mpc_parser_t *rule) {
+  return mpc_apply_to(a, (mpc_apply_to_t)mpc_ast_add_rule, rule);
+}
+
 mpc_parser_t *mpca_root(mpc_parser_t *a) {
   return mpc_apply(a, (mpc_apply_t)mpc_ast_add_root);
 }
@@ -3198,7 +4776,7 @@ static mpc_val_t *mpcaf_grammar_string(mpc_val_t *x, void *s) {
   char *y = mpcf_unescape(x);
   mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_string(y) : mpc_tok(mpc_string(y));
   free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "string"));
+  return mpca_state(mpc_apply_to(mpc_apply(p, mpcf_str_ast), (mpc_apply_to_t)mpc_ast_tag_string, "string"));
 }
 
 static mpc_val_t *mpcaf_grammar_char(mpc_val_t *x, void *s) {
@@ -3206,7 +4784,7 @@ static mpc_val_t *mpcaf_grammar_char(mpc_val_t *x, void *s) {
   char *y = mpcf_unescape(x);
   mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_char(y[0]) : mpc_tok(mpc_char(y[0]));
   free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "char"));
+  return mpca_state(mpc_apply_to(mpc_apply(p, mpcf_str_ast), (mpc_apply_to_t)mpc_ast_tag_char, "char"));
 }
 
 static mpc_val_t *mpcaf_grammar_regex(mpc_val_t *x, void *s) {
@@ -3214,7 +4792,7 @@ static mpc_val_t *mpcaf_grammar_regex(mpc_val_t *x, void *s) {
   char *y = mpcf_unescape_regex(x);
   mpc_parser_t *p = (st->flags & MPCA_LANG_WHITESPACE_SENSITIVE) ? mpc_re(y) : mpc_tok(mpc_re(y));
   free(y);
-  return mpca_state(mpca_tag(mpc_apply(p, mpcf_str_ast), "regex"));
+  return mpca_state(mpc_apply_to(mpc_apply(p, mpcf_str_ast), (mpc_apply_to_t)mpc_ast_tag_regex, "regex"));
 }
 
 /* Should this just use `isdigit` instead? */
@@ -3280,7 +4858,7 @@ static mpc_val_t *mpcaf_grammar_id(mpc_val_t *x, void *s) {
   free(x);
 
   if (p->name) {
-    return mpca_state(mpca_root(mpca_add_tag(p, p->name)));
+    return mpca_state(mpca_root(mpca_add_rule(p, p)));
   } else {
     return mpca_state(mpca_root(p));
   }
@@ -3373,6 +4951,7 @@ mpc_parser_t *mpca_grammar(int flags, const char *grammar, ...) {
 typedef struct {
   char *ident;
   char *name;
+  int memo;
   mpc_parser_t *grammar;
 } mpca_stmt_t;
 
@@ -3380,10 +4959,12 @@ static mpc_val_t *mpca_stmt_afold(int n, mpc_val_t **xs) {
   mpca_stmt_t *stmt = malloc(sizeof(mpca_stmt_t));
   stmt->ident = ((char**)xs)[0];
   stmt->name = ((char**)xs)[1];
-  stmt->grammar = ((mpc_parser_t**)xs)[3];
+  stmt->memo = xs[2] != NULL;
+  stmt->grammar = ((mpc_parser_t**)xs)[4];
   (void) n;
   free(((char**)xs)[2]);
-  free(((char**)xs)[4]);
+  free(((char**)xs)[3]);
+  free(((char**)xs)[5]);
   
   return stmt;
 }
@@ -3431,6 +5012,7 @@ static mpc_val_t *mpca_stmt_list_apply_to(mpc_val_t *x, void *s) {
     if (stmt->name) { stmt->grammar = mpc_expect(stmt->grammar, stmt->name); }
     mpc_optimise(stmt->grammar);
     mpc_define(left, stmt->grammar);
+    left->memo = stmt->memo;
     free(stmt->ident);
     free(stmt->name);
     free(stmt);
@@ -3460,9 +5042,10 @@ static mpc_err_t *mpca_lang_st(mpc_input_t *i, mpca_grammar_st_t *st) {
     mpca_stmt_list_apply_to, st
   ));
   
-  mpc_define(Stmt, mpc_and(5, mpca_stmt_afold,
-    mpc_tok(mpc_ident()), mpc_maybe(mpc_tok(mpc_string_lit())), mpc_sym(":"), Grammar, mpc_sym(";"),
-    free, free, free, mpc_soft_delete
+  mpc_define(Stmt, mpc_and(6, mpca_stmt_afold,
+    mpc_tok(mpc_ident()), mpc_maybe(mpc_tok(mpc_string_lit())), mpc_maybe(mpc_sym("@memo")),
+    mpc_sym(":"), Grammar, mpc_sym(";"),
+    free, free, free, free, mpc_soft_delete
   ));
   
   mpc_define(Grammar, mpc_and(2, mpcaf_grammar_or,
@@ -3593,6 +5176,9 @@ mpc_err_t *mpca_lang_contents(int flags, const char *filename, ...) {
     return err;
   }
   
+  i = mpc_input_new_mmap(filename, f);
+  if (i == NULL) { i = mpc_input_new_file(filename, f); }
+  
   va_start(va, filename);
   
   st.va = &va;
@@ -3600,7 +5186,6 @@ mpc_err_t *mpca_lang_contents(int flags, const char *filename, ...) {
   st.parsers = NULL;
   st.flags = flags;
   
-  i = mpc_input_new_file(filename, f);
   err = mpca_lang_st(i, &st);
   mpc_input_delete(i);
   
@@ -3630,6 +5215,8 @@ static int mpc_nodecount_unretained(mpc_parser_t* p, int force) {
   if (p->type == MPC_TYPE_MANY)  { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
   if (p->type == MPC_TYPE_MANY1) { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
   if (p->type == MPC_TYPE_COUNT) { return 1 + mpc_nodecount_unretained(p->data.repeat.x, 0); }
+  
+  if (p->type == MPC_TYPE_DFA) { return 1 + mpc_nodecount_unretained(p->data.dfa.x, 0); }
 
   if (p->type == MPC_TYPE_OR) { 
     total = 0;
@@ -3651,10 +5238,266 @@ static int mpc_nodecount_unretained(mpc_parser_t* p, int force) {
   
 }
 
+/* Add every parser reachable from 'p' not already in 'seen' to it */
+static void mpc_stats_reach(mpc_parser_t *p, mpc_parser_t ***seen, int *n) {
+  
+  int j;
+  
+  for (j = 0; j < *n; j++) { if ((*seen)[j] == p) { return; } }
+  *seen = realloc(*seen, sizeof(mpc_parser_t*) * (*n + 1));
+  (*seen)[(*n)++] = p;
+  
+  switch (p->type) {
+    case MPC_TYPE_EXPECT:   mpc_stats_reach(p->data.expect.x, seen, n);   break;
+    case MPC_TYPE_APPLY:    mpc_stats_reach(p->data.apply.x, seen, n);    break;
+    case MPC_TYPE_APPLY_TO: mpc_stats_reach(p->data.apply_to.x, seen, n); break;
+    case MPC_TYPE_PREDICT:  mpc_stats_reach(p->data.predict.x, seen, n);  break;
+    case MPC_TYPE_NOT:
+    case MPC_TYPE_MAYBE:    mpc_stats_reach(p->data.not.x, seen, n);      break;
+    case MPC_TYPE_MANY:
+    case MPC_TYPE_MANY1:
+    case MPC_TYPE_COUNT:    mpc_stats_reach(p->data.repeat.x, seen, n);   break;
+    case MPC_TYPE_DFA:      mpc_stats_reach(p->data.dfa.x, seen, n);      break;
+    case MPC_TYPE_OR:
+      for (j = 0; j < p->data.or.n; j++) { mpc_stats_reach(p->data.or.xs[j], seen, n); }
+      break;
+    case MPC_TYPE_AND:
+      for (j = 0; j < p->data.and.n; j++) { mpc_stats_reach(p->data.and.xs[j], seen, n); }
+      break;
+    default: break;
+  }
+}
+
+static double mpc_stats_rate(unsigned long hits, unsigned long lookups) {
+  return lookups ? 100.0 * hits / lookups : 0.0;
+}
+
 void mpc_stats(mpc_parser_t* p) {
+  
+  mpc_parser_t **seen = NULL;
+  unsigned long hits = 0, lookups = 0, evicted = 0;
+  int j, n = 0, rules = 0;
+  
   printf("Stats\n");
   printf("=====\n");
   printf("Node Count: %i\n", mpc_nodecount_unretained(p, 1));
+  
+  /* Hit rates of the memoized rules, over every parse so far */
+  mpc_stats_reach(p, &seen, &n);
+  for (j = 0; j < n; j++) {
+    if (!seen[j]->memo) { continue; }
+    rules++;
+    hits += seen[j]->memo_hits;
+    lookups += seen[j]->memo_lookups;
+    evicted += seen[j]->memo_evicted;
+  }
+  
+  if (rules) {
+    printf("Memo Rules: %i\n", rules);
+    printf("Memo Hits: %lu of %lu (%.1f%%)\n", hits, lookups, mpc_stats_rate(hits, lookups));
+    printf("Memo Evicted: %lu\n", evicted);
+    for (j = 0; j < n; j++) {
+      if (!seen[j]->memo) { continue; }
+      printf("  %s: %lu of %lu (%.1f%%), %lu evicted\n", seen[j]->name,
+        seen[j]->memo_hits, seen[j]->memo_lookups,
+        mpc_stats_rate(seen[j]->memo_hits, seen[j]->memo_lookups),
+        seen[j]->memo_evicted);
+    }
+  }
+  
+  free(seen);
+}
+
+/*
+** FIRST sets, for the dispatch tables of 'or'. For every parser this
+** finds the characters it can start with, and if it is nullable, that
+** is, might succeed without reading anything. Anchors, 'not' and
+** 'satisfy' look further than the next character, so they are taken
+** to be nullable and to start with anything. Rules refer to each
+** other, so it goes round the graph until nothing changes.
+*/
+
+typedef struct {
+  int n;
+  mpc_parser_t **xs;
+  unsigned char *first;
+  char *nullable;
+} mpc_first_t;
+
+static int mpc_first_cmp(const void *a, const void *b) {
+  const mpc_parser_t *x = *(mpc_parser_t* const*)a;
+  const mpc_parser_t *y = *(mpc_parser_t* const*)b;
+  return x < y ? -1 : x > y;
+}
+
+/* 'xs' is sorted by address, so a parser's index is found by search */
+static int mpc_first_index(mpc_first_t *f, mpc_parser_t *p) {
+  mpc_parser_t **x = bsearch(&p, f->xs, f->n, sizeof(mpc_parser_t*), mpc_first_cmp);
+  return (int)(x - f->xs);
+}
+
+/* Add what 'x' starts with to 'bits', returning if it is nullable */
+static int mpc_first_add(mpc_first_t *f, mpc_parser_t *x, unsigned char *bits) {
+  int j, k = mpc_first_index(f, x);
+  for (j = 0; j < 32; j++) { bits[j] |= f->first[32 * k + j]; }
+  return f->nullable[k];
+}
+
+/* Work out parser 'k' again from what is known of its children; returns if it grew */
+static int mpc_first_step(mpc_first_t *f, int k) {
+  
+  mpc_parser_t *p = f->xs[k];
+  unsigned char bits[32];
+  int j, z = 0;
+  
+  memcpy(bits, f->first + 32 * k, 32);
+  
+  switch (p->type) {
+    
+    case MPC_TYPE_PASS:
+    case MPC_TYPE_LIFT:
+    case MPC_TYPE_LIFT_VAL:
+    case MPC_TYPE_STATE:
+      z = 1;
+      break;
+    
+    case MPC_TYPE_ANCHOR:
+    case MPC_TYPE_SATISFY:
+    case MPC_TYPE_NOT:
+      memset(bits, 0xFF, 32);
+      z = 1;
+      break;
+    
+    case MPC_TYPE_ANY: memset(bits, 0xFF, 32); break;
+    
+    case MPC_TYPE_SINGLE:
+      j = (unsigned char)p->data.single.x;
+      bits[j >> 3] |= (unsigned char)(1 << (j & 7));
+      break;
+    
+    case MPC_TYPE_RANGE:
+      for (j = 0; j < 256; j++) {
+        if ((char)j >= p->data.range.x && (char)j <= p->data.range.y) {
+          bits[j >> 3] |= (unsigned char)(1 << (j & 7));
+        }
+      }
+      break;
+    
+    case MPC_TYPE_ONEOF:
+    case MPC_TYPE_NONEOF:
+      for (j = 0; j < 32; j++) { bits[j] |= p->data.string.bits[j]; }
+      break;
+    
+    case MPC_TYPE_STRING:
+      j = (unsigned char)p->data.string.x[0];
+      if (j) { bits[j >> 3] |= (unsigned char)(1 << (j & 7)); } else { z = 1; }
+      break;
+    
+    case MPC_TYPE_EXPECT:   z = mpc_first_add(f, p->data.expect.x, bits);   break;
+    case MPC_TYPE_APPLY:    z = mpc_first_add(f, p->data.apply.x, bits);    break;
+    case MPC_TYPE_APPLY_TO: z = mpc_first_add(f, p->data.apply_to.x, bits); break;
+    case MPC_TYPE_PREDICT:  z = mpc_first_add(f, p->data.predict.x, bits);  break;
+    case MPC_TYPE_DFA:      z = mpc_first_add(f, p->data.dfa.x, bits);      break;
+    
+    case MPC_TYPE_MAYBE: mpc_first_add(f, p->data.not.x, bits); z = 1; break;
+    case MPC_TYPE_MANY:  mpc_first_add(f, p->data.repeat.x, bits); z = 1; break;
+    case MPC_TYPE_MANY1: z = mpc_first_add(f, p->data.repeat.x, bits); break;
+    case MPC_TYPE_COUNT:
+      z = mpc_first_add(f, p->data.repeat.x, bits) || p->data.repeat.n == 0;
+      break;
+    
+    case MPC_TYPE_OR:
+      z = p->data.or.n == 0;
+      for (j = 0; j < p->data.or.n; j++) {
+        if (mpc_first_add(f, p->data.or.xs[j], bits)) { z = 1; }
+      }
+      break;
+    
+    /* Each goes on to the next only while all so far may have read nothing */
+    case MPC_TYPE_AND:
+      z = 1;
+      for (j = 0; j < p->data.and.n && z; j++) {
+        z = mpc_first_add(f, p->data.and.xs[j], bits);
+      }
+      break;
+    
+    default: break;
+  }
+  
+  if (z == f->nullable[k] && memcmp(bits, f->first + 32 * k, 32) == 0) { return 0; }
+  f->nullable[k] = (char)z;
+  memcpy(f->first + 32 * k, bits, 32);
+  return 1;
+}
+
+static mpc_or_table_t *mpc_or_table_new(mpc_first_t *f, mpc_parser_t *p) {
+  
+  int c, j, k, n = p->data.or.n;
+  unsigned char *v;
+  mpc_or_table_t *t = malloc(sizeof(mpc_or_table_t));
+  
+  t->gen = mpc_or_gen;
+  t->viable = malloc(32 * n);
+  t->skips = calloc(n, sizeof(mpc_or_skip_t));
+  t->leads = calloc(n + 1, sizeof(mpc_or_skip_t));
+  
+  for (j = 0; j < n; j++) {
+    v = t->viable + 32 * j;
+    k = mpc_first_index(f, p->data.or.xs[j]);
+    if (f->nullable[k]) {
+      memset(v, 0xFF, 32);
+    } else {
+      memcpy(v, f->first + 32 * k, 32);
+    }
+    /* The end of the input reads as '\0', so that is never skipped on */
+    v[0] |= 1;
+  }
+  
+  for (c = 0; c < 256; c++) {
+    for (j = 0; j < n && !MPC_CLASS_HAS(t->viable + 32 * j, c); j++);
+    t->start[c] = (unsigned char)(j < 255 ? j : 255);
+  }
+  
+  return t;
+}
+
+/* The table for 'or' parser 'p', building it and those of every other 'or' it reaches if out of date */
+static mpc_or_table_t *mpc_or_table(mpc_parser_t *p) {
+  
+  mpc_first_t f;
+  mpc_parser_t *q;
+  int k, changed;
+  
+#ifdef MPC_NO_DISPATCH
+  return NULL;
+#endif
+  
+  if (p->data.or.t && p->data.or.t->gen == mpc_or_gen) { return p->data.or.t; }
+  
+  f.n = 0;
+  f.xs = NULL;
+  mpc_stats_reach(p, &f.xs, &f.n);
+  qsort(f.xs, f.n, sizeof(mpc_parser_t*), mpc_first_cmp);
+  f.first = calloc(f.n, 32);
+  f.nullable = calloc(f.n, 1);
+  
+  do {
+    changed = 0;
+    for (k = 0; k < f.n; k++) { changed |= mpc_first_step(&f, k); }
+  } while (changed);
+  
+  for (k = 0; k < f.n; k++) {
+    q = f.xs[k];
+    if (q->type != MPC_TYPE_OR || q->data.or.n < 2) { continue; }
+    if (q->data.or.t && q->data.or.t->gen == mpc_or_gen) { continue; }
+    mpc_or_table_delete(q->data.or.t, q->data.or.n);
+    q->data.or.t = mpc_or_table_new(&f, q);
+  }
+  
+  free(f.nullable);
+  free(f.first);
+  free(f.xs);
+  return p->data.or.t;
 }
 
 static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
@@ -3675,6 +5518,7 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
   if (p->type == MPC_TYPE_MANY)     { mpc_optimise_unretained(p->data.repeat.x, 0); }
   if (p->type == MPC_TYPE_MANY1)    { mpc_optimise_unretained(p->data.repeat.x, 0); }
   if (p->type == MPC_TYPE_COUNT)    { mpc_optimise_unretained(p->data.repeat.x, 0); }
+  if (p->type == MPC_TYPE_DFA)      { mpc_optimise_unretained(p->data.dfa.x, 0); }
   
   if (p->type == MPC_TYPE_OR) { 
     for(i = 0; i < p->data.or.n; i++) {
@@ -3690,6 +5534,11 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
   
   /* Perform optimisations */
   
+  if (p->type == MPC_TYPE_OR) {
+    mpc_or_table_delete(p->data.or.t, p->data.or.n);
+    p->data.or.t = NULL;
+  }
+  
   while (1) {
     
     /* Merge rhs `or` */
@@ -3701,6 +5550,7 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
       p->data.or.n = n + m - 1;
       p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
       memmove(p->data.or.xs + n - 1, t->data.or.xs, m * sizeof(mpc_parser_t*));
+      mpc_or_table_delete(t->data.or.t, m);
       free(t->data.or.xs); free(t->name); free(t);
       continue;
     }
@@ -3713,8 +5563,9 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
       n = p->data.or.n; m = t->data.or.n;
       p->data.or.n = n + m - 1;
       p->data.or.xs = realloc(p->data.or.xs, sizeof(mpc_parser_t*) * (n + m -1));
-      memmove(p->data.or.xs + m, t->data.or.xs + 1, n * sizeof(mpc_parser_t*));
+      memmove(p->data.or.xs + m, p->data.or.xs + 1, (n - 1) * sizeof(mpc_parser_t*));
       memmove(p->data.or.xs, t->data.or.xs, m * sizeof(mpc_parser_t*));
+      mpc_or_table_delete(t->data.or.t, m);
       free(t->data.or.xs); free(t->name); free(t);
       continue;
     }
@@ -3825,6 +5676,7 @@ static void mpc_optimise_unretained(mpc_parser_t *p, int force) {
 }
 
 void mpc_optimise(mpc_parser_t *p) {
+  mpc_or_gen++;
   mpc_optimise_unretained(p, 1);
 }
 
@@ -68,6 +68,7 @@ int mpc_parse(const char *filename, const char *string, mpc_parser_t *p, mpc_res
 int mpc_nparse(const char *filename, const char *string, size_t length, mpc_parser_t *p, mpc_result_t *r);
 int mpc_parse_file(const char *filename, FILE *file, mpc_parser_t *p, mpc_result_t *r);
 int mpc_parse_pipe(const char *filename, FILE *pipe, mpc_parser_t *p, mpc_result_t *r);
+/* Maps 'filename' and parses it in place if it is a regular file */
 int mpc_parse_contents(const char *filename, mpc_parser_t *p, mpc_result_t *r);
 
 /*
@@ -87,6 +88,9 @@ typedef mpc_val_t*(*mpc_fold_t)(int,mpc_val_t**);
 
 mpc_parser_t *mpc_new(const char *name);
 mpc_parser_t *mpc_copy(mpc_parser_t *a);
+
+/* Small integer naming a parser made by mpc_new; 0 for any other */
+int mpc_parser_id(mpc_parser_t *p);
 mpc_parser_t *mpc_define(mpc_parser_t *p, mpc_parser_t *a);
 mpc_parser_t *mpc_undefine(mpc_parser_t *p);
 
@@ -255,18 +259,44 @@ mpc_val_t *mpcf_maths(int n, mpc_val_t** xs);
 ** Regular Expression Parsers
 */
 
+/*
+** Where the next character always decides how a regex goes on, as in
+** '-?[0-9]+' or '[a-z_][a-z0-9_]*', it is matched from a table in one
+** pass with one allocation. Other regexes, such as 'a*a', and inputs
+** where backtracking is off run on the combinators as before. Results
+** and errors are the same either way.
+*/
 mpc_parser_t *mpc_re(const char *re);
   
 /*
 ** AST
 */
 
+/*
+** Every node records what made it, so consumers can switch on
+** integers rather than search 'tag', which is kept for printing.
+** 'kind' says whether a node is a terminal or folded children, and
+** 'rule' is the mpc_parser_id of the innermost named rule that
+** produced it, or 0 for literals and anchors that belong to no rule.
+*/
+
+typedef enum {
+  MPC_AST_OTHER,
+  MPC_AST_NODE,
+  MPC_AST_STRING,
+  MPC_AST_CHAR,
+  MPC_AST_REGEX
+} mpc_ast_kind_t;
+
 typedef struct mpc_ast_t {
   char *tag;
   char *contents;
   mpc_state_t state;
   int children_num;
   struct mpc_ast_t** children;
+  int rule;
+  int kind;
+  struct mpc_ast_arena_t *arena;
 } mpc_ast_t;
 
 mpc_ast_t *mpc_ast_new(const char *tag, const char *contents);
@@ -278,6 +308,16 @@ mpc_ast_t *mpc_ast_add_root_tag(mpc_ast_t *a, const char *t);
 mpc_ast_t *mpc_ast_tag(mpc_ast_t *a, const char *t);
 mpc_ast_t *mpc_ast_state(mpc_ast_t *a, mpc_state_t s);
 
+/*
+** Arena mode. While it is on, every AST built by mpc_parse and
+** friends has its nodes, child arrays and contents carved from one
+** bump allocator, and its tags interned in a table kept by the
+** parser passed in. mpc_ast_delete on the root releases the whole
+** tree at once and is a no-op on any other node of it. Such a tree
+** must not outlive that parser. Returns the previous setting.
+*/
+int mpc_ast_arena_set(int on);
+
 void mpc_ast_delete(mpc_ast_t *a);
 void mpc_ast_print(mpc_ast_t *a);
 void mpc_ast_print_to(mpc_ast_t *a, FILE *fp);
@@ -287,6 +327,10 @@ int mpc_ast_get_index_lb(mpc_ast_t *ast, const char *tag, int lb);
 mpc_ast_t *mpc_ast_get_child(mpc_ast_t *ast, const char *tag);
 mpc_ast_t *mpc_ast_get_child_lb(mpc_ast_t *ast, const char *tag, int lb);
 
+/* The same, matching the rule id instead of the tag */
+int mpc_ast_get_index_rule(mpc_ast_t *ast, int rule, int lb);
+mpc_ast_t *mpc_ast_get_child_rule(mpc_ast_t *ast, int rule, int lb);
+
 typedef enum {
   mpc_ast_trav_order_pre,
   mpc_ast_trav_order_post
@@ -317,6 +361,7 @@ mpc_val_t *mpcf_state_ast(int n, mpc_val_t **xs);
 
 mpc_parser_t *mpca_tag(mpc_parser_t *a, const char *t);
 mpc_parser_t *mpca_add_tag(mpc_parser_t *a, const char *t);
+mpc_parser_t *mpca_add_rule(mpc_parser_t *a, mpc_parser_t *rule);
 mpc_parser_t *mpca_root(mpc_parser_t *a);
 mpc_parser_t *mpca_state(mpc_parser_t *a);
 mpc_parser_t *mpca_total(mpc_parser_t *a);
@@ -344,6 +389,18 @@ mpc_err_t *mpca_lang_file(int flags, FILE *f, ...);
 mpc_err_t *mpca_lang_pipe(int flags, FILE *f, ...);
 mpc_err_t *mpca_lang_contents(int flags, const char *filename, ...);
 
+/*
+** A rule written 'name @memo : ...' in mpca_lang is memoized: what it
+** did at each position is kept for the rest of the parse, so trying it
+** there again after backtracking costs a copy instead of a reparse.
+** Worth it for rules that sit at the front of several alternatives.
+** Not used while backtracking is off, as with MPCA_LANG_PREDICTIVE.
+** The memo of one parse holds at most 'bytes' (16 MB by default).
+** Returns the previous budget. mpc_stats reports the hit rates and
+** how many entries the budget pushed out.
+*/
+size_t mpc_memo_set_budget(size_t bytes);
+
 /*
 ** Misc
 */
@@ -0,0 +1,292 @@
+#define _POSIX_C_SOURCE 200809L
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "reader.h"
+
+/*
+  Lists being read are kept on an explicit stack rather than the C
+  stack, so deep nesting costs memory, not recursion. Each new list
+  is added to its parent when it opens, which means the root owns
+  everything read so far and an error only has to delete the root.
+*/
+
+/* Character classes of the grammar's terminals */
+enum { C_OTHER, C_SPACE, C_DIGIT, C_SYMBOL };
+
+static unsigned char char_class[256];
+
+static void reader_init(void) {
+    if (char_class[' ']) { return; }
+    for (const char* c = " \t\n\r\f\v"; *c; c++) {
+        char_class[(unsigned char)*c] = C_SPACE;
+    }
+    for (const char* c = "abcdefghijklmnopqrstuvwxyz"
+                         "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                         "_+-*/\\=<>!&%^"; *c; c++) {
+        char_class[(unsigned char)*c] = C_SYMBOL;
+    }
+    for (int c = '0'; c <= '9'; c++) { char_class[c] = C_DIGIT; }
+}
+
+/* A syntax error at 'p', located by line and column from 's' at 'line', 'col' */
+static lval* reader_err(const char* name, int line, int col,
+                        const char* s, const char* p, const char* what) {
+    for (const char* q = s; q < p; q++) {
+        if (*q == '\n') { line++; col = 1; } else { col++; }
+    }
+    char buf[256];
+    snprintf(buf, sizeof buf, "%s:%d:%d: error: %s", name, line, col, what);
+    return lval_err(buf);
+}
+
+/* Digits at 'p', optionally after a '-', as /-?[0-9]+/; NULL past a long */
+static lval* read_num(const char** pp, const char* end) {
+    const char* p = *pp;
+    int neg = *p == '-';
+    if (neg) { p++; }
+
+    /* Accumulate towards the sign, so LONG_MIN fits */
+    long x = 0;
+    int range = 1;
+    for (; p < end && char_class[(unsigned char)*p] == C_DIGIT; p++) {
+        int d = *p - '0';
+        if (!range) { continue; }
+        if (neg ? x < (LONG_MIN + d) / 10 : x > (LONG_MAX - d) / 10) {
+            range = 0;
+            continue;
+        }
+        x = x * 10 + (neg ? -d : d);
+    }
+    *pp = p;
+    return range ? lval_num(x) : NULL;
+}
+
+lval* lval_read_str(const char* name, const char* s, size_t len) {
+    return lval_read_at(name, 1, 1, s, len);
+}
+
+lval* lval_read_at(const char* name, int line, int col,
+                   const char* s, size_t len) {
+    reader_init();
+    const char* p = s;
+    const char* end = s + len;
+
+    lval* root = lval_sexpr();
+    lval* cur = root;
+    lval** open = NULL;
+    int depth = 0, cap = 0;
+
+    while (1) {
+        while (p < end && char_class[(unsigned char)*p] == C_SPACE) { p++; }
+        if (p == end) { break; }
+
+        char c = *p;
+        int cls = char_class[(unsigned char)c];
+
+        /* Numbers first, as the 'expr' rule tries them first */
+        if (cls == C_DIGIT || (c == '-' && p + 1 < end
+                && char_class[(unsigned char)p[1]] == C_DIGIT)) {
+            const char* start = p;
+            lval* x = read_num(&p, end);
+            if (x == NULL) {
+                lval* err = reader_err(name, line, col, s, start,
+                                       "invalid number");
+                lval_del(root);
+                free(open);
+                return err;
+            }
+            cur = lval_add(cur, x);
+            continue;
+        }
+
+        if (cls == C_SYMBOL) {
+            const char* q = p;
+            while (q < end && char_class[(unsigned char)*q] >= C_DIGIT) { q++; }
+            cur = lval_add(cur, lval_sym_n(p, q - p));
+            p = q;
+            continue;
+        }
+
+        if (c == '(' || c == '{') {
+            if (depth == cap) {
+                cap = cap ? cap * 2 : 16;
+                open = realloc(open, sizeof(lval*) * cap);
+            }
+            lval* x = c == '(' ? lval_sexpr() : lval_qexpr();
+            open[depth++] = lval_add(cur, x);
+            cur = x;
+            p++;
+            continue;
+        }
+
+        if ((c == ')' || c == '}') && depth > 0
+            && cur->type == (c == ')' ? LVAL_SEXPR : LVAL_QEXPR)) {
+            lval_shrink(cur);
+            cur = open[--depth];
+            p++;
+            continue;
+        }
+
+        char what[32];
+        if (isprint((unsigned char)c)) {
+            snprintf(what, sizeof what, "unexpected '%c'", c);
+        } else {
+            snprintf(what, sizeof what, "unexpected byte 0x%02x", (unsigned char)c);
+        }
+        lval* err = reader_err(name, line, col, s, p, what);
+        lval_del(root);
+        free(open);
+        return err;
+    }
+
+    if (depth > 0) {
+        lval* err = reader_err(name, line, col, s, p, cur->type == LVAL_SEXPR
+                               ? "expected ')' at end of input"
+                               : "expected '}' at end of input");
+        lval_del(root);
+        free(open);
+        return err;
+    }
+
+    free(open);
+    return lval_shrink(root);
+}
+
+/*
+  The stream only finds where each form ends; reading it is left to
+  lval_read_at or mpc. A list ends where its brackets balance, without
+  checking that they match, and anything else ends at the next space
+  or bracket. Scanning picks up where the last read left off, so a
+  form arriving in many pieces is still scanned once.
+*/
+
+enum { STREAM_CHUNK = 64 * 1024 };
+
+enum { FORM_NONE, FORM_LIST, FORM_ATOM };
+
+struct lstream {
+    int fd;
+    int eof;
+    /* Bytes held, plus room for a NUL after the last one */
+    char* buf;
+    size_t cap;
+    size_t end;
+    /* Start of the current form and how far it has been scanned */
+    size_t start;
+    size_t pos;
+    int form;
+    int depth;
+    /* Where buf[start] is in the input */
+    int line;
+    int col;
+    /* The byte a NUL was written over to end the last form */
+    char saved;
+    int has_saved;
+};
+
+lstream* lstream_new(int fd) {
+    reader_init();
+    lstream* s = calloc(1, sizeof(lstream));
+    s->fd = fd;
+    s->line = s->col = 1;
+    return s;
+}
+
+void lstream_del(lstream* s) {
+    free(s->buf);
+    free(s);
+}
+
+/* Move the start of the stream up to 'to', keeping count of lines */
+static void lstream_skip(lstream* s, size_t to) {
+    for (; s->start < to; s->start++) {
+        if (s->buf[s->start] == '\n') { s->line++; s->col = 1; } else { s->col++; }
+    }
+}
+
+/* Scan on from 'pos'; true once buf[start, pos) is a whole form */
+static int lstream_scan(lstream* s) {
+    for (; s->pos < s->end; s->pos++) {
+        char c = s->buf[s->pos];
+        int space = char_class[(unsigned char)c] == C_SPACE;
+        int open = c == '(' || c == '{';
+        int close = c == ')' || c == '}';
+
+        switch (s->form) {
+        case FORM_NONE:
+            if (space) { continue; }
+            lstream_skip(s, s->pos);
+            if (close) { s->pos++; return 1; }
+            s->form = open ? FORM_LIST : FORM_ATOM;
+            s->depth = open;
+            break;
+
+        case FORM_ATOM:
+            if (space || open || close) { return 1; }
+            break;
+
+        case FORM_LIST:
+            if (open) { s->depth++; }
+            if (close && --s->depth == 0) { s->pos++; return 1; }
+            break;
+        }
+    }
+
+    /* Nothing more is coming, so whatever has started is finished */
+    if (s->eof) { return s->form != FORM_NONE; }
+
+    /* Spaces between forms need not be kept */
+    if (s->form == FORM_NONE) { lstream_skip(s, s->pos); }
+    return 0;
+}
+
+/* Make room and read more; sets 'eof' when there is no more */
+static void lstream_fill(lstream* s) {
+    if (s->start > 0) {
+        memmove(s->buf, s->buf + s->start, s->end - s->start);
+        s->end -= s->start;
+        s->pos -= s->start;
+        s->start = 0;
+    }
+    if (s->cap - s->end < STREAM_CHUNK) {
+        s->cap = s->cap ? s->cap * 2 : STREAM_CHUNK;
+        s->buf = realloc(s->buf, s->cap + 1);
+    }
+
+    fflush(stdout);
+    ssize_t n;
+    do {
+        n = read(s->fd, s->buf + s->end, s->cap - s->end);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) { s->eof = 1; } else { s->end += n; }
+}
+
+const char* lstream_next(lstream* s, size_t* len, int* line, int* col) {
+    /* Put back what the last form's NUL covered, then move past it */
+    if (s->has_saved) {
+        s->buf[s->pos] = s->saved;
+        s->has_saved = 0;
+    }
+    lstream_skip(s, s->pos);
+    s->form = FORM_NONE;
+
+    while (!lstream_scan(s)) {
+        if (s->eof) { return NULL; }
+        lstream_fill(s);
+    }
+
+    s->saved = s->buf[s->pos];
+    s->has_saved = 1;
+    s->buf[s->pos] = '\0';
+
+    *len = s->pos - s->start;
+    *line = s->line;
+    *col = s->col;
+    return s->buf + s->start;
+}
@@ -0,0 +1,52 @@
+#ifndef reader_h
+#define reader_h
+
+#include <stddef.h>
+#include "lispy.h"
+
+/*
+  A single-pass reader for the Lispy grammar. It scans the input once
+  and builds lvals directly, with no intermediate AST: numbers are
+  converted and symbols interned straight from the buffer.
+
+  It reads exactly what the mpc grammar in lispy_parser accepts, and
+  that path stays available through lval_read for grammar work.
+*/
+
+/**
+ * Read every expression in the 'len' bytes at 's' into one
+ * S-Expression, as the 'lispy' rule does. The input need not be
+ * NUL-terminated. A syntax error gives an LVAL_ERR instead, naming
+ * the place with 'name', as in "<stdin>:1:7: error: unexpected ')'".
+ **/
+lval* lval_read_str(const char* name, const char* s, size_t len);
+
+/**
+ * The same for text found at 'line' and 'col' of a larger input, so
+ * that errors are placed in the whole input rather than in 's'.
+ **/
+lval* lval_read_at(const char* name, int line, int col,
+                   const char* s, size_t len);
+
+/*
+  Top-level forms read incrementally from a file descriptor, so that
+  a script can be evaluated while the rest of it is still arriving.
+  Only the form being read is kept in memory, along with whatever the
+  last read() brought in after it. Before blocking on more input the
+  stream flushes stdout, so results show up as their forms complete.
+*/
+typedef struct lstream lstream;
+
+lstream* lstream_new(int fd);
+void lstream_del(lstream* s);
+
+/**
+ * The text of the next top-level form, NUL-terminated, valid until
+ * the next call. Its length goes in 'len' and where it starts in
+ * 'line' and 'col'. Returns NULL at the end of input. Text that is
+ * not a well-formed form, like a stray ')' or a list still open at
+ * the end, is returned as it is, for the reader to report.
+ **/
+const char* lstream_next(lstream* s, size_t* len, int* line, int* col);
+
+#endif
@@ -5,4 +5,5 @@
 
 #include <stdlib.h>
 
+/* base to the power exp; exp must not be negative */
 long power(long base, long exp);
@@ -0,0 +1,194 @@
+#include <stdlib.h>
+
+#include "vm.h"
+#include "gc.h"
+
+/*
+  One value stack shared by every chunk being run. Frames are kept
+  as indices rather than pointers, since a nested run may grow it.
+*/
+static lval** stack = NULL;
+static int stack_cap = 0;
+static int sp = 0;
+
+#ifdef LISPY_GC
+/* Chunks being run; their constants are roots */
+static lchunk** running = NULL;
+static int running_num = 0;
+static int running_cap = 0;
+
+void lvm_roots(void (*mark)(lval* v)) {
+    for (int i = 0; i < sp; i++) { mark(stack[i]); }
+    for (int i = 0; i < running_num; i++) {
+        lchunk* c = running[i];
+        for (int j = 0; j < c->consts_num; j++) { mark(c->consts[j]); }
+    }
+}
+
+static void lvm_enter(lchunk* c) {
+    if (running_num == running_cap) {
+        running_cap = running_cap ? running_cap * 2 : 16;
+        running = realloc(running, sizeof(lchunk*) * running_cap);
+    }
+    running[running_num++] = c;
+}
+
+static void lvm_leave(void) {
+    running_num--;
+}
+#else
+#define lvm_enter(c) ((void)0)
+#define lvm_leave()  ((void)0)
+#endif
+
+static void lvm_reserve(int n) {
+    if (sp + n <= stack_cap) { return; }
+    while (sp + n > stack_cap) { stack_cap = stack_cap ? stack_cap * 2 : 256; }
+    stack = realloc(stack, sizeof(lval*) * stack_cap);
+}
+
+static lval* lvm_load(lenv* e, lvm_global* g) {
+    /* A binding only moves when the table grows; recheck the cache */
+    if (g->slot < 0 || g->slot >= e->slots || e->syms[g->slot] != g->sym) {
+        g->slot = lenv_find(e, g->sym);
+        /* Not local; enclosing scopes are searched without caching */
+        if (g->slot < 0) {
+            for (lenv* p = e->par; p; p = p->par) {
+                int i = lenv_find(p, g->sym);
+                if (i >= 0) { return lval_ref(p->vals[i]); }
+            }
+            return lval_err("unbound symbol!");
+        }
+    }
+    return lval_ref(e->vals[g->slot]);
+}
+
+/* Apply evaluated elements 'xs', consuming them, as lval_eval_sexpr does */
+static lval* lvm_apply(lenv* e, lval** xs, int n) {
+
+    /* Error Checking */
+    for (int i = 0; i < n; i++) {
+        if (lval_type(xs[i]) != LVAL_ERR) { continue; }
+        lval* x = xs[i];
+        for (int j = 0; j < n; j++) {
+            if (j != i) { lval_del(xs[j]); }
+        }
+        return x;
+    }
+
+    /* Empty Expr */
+    if (n == 0) { return lval_sexpr(); }
+
+    /*Single Expr */
+    if (n == 1) { return xs[0]; }
+
+    /* Ensure first element is function after eval */
+    lval* f = xs[0];
+    if (lval_type(f) != LVAL_FUN && lval_type(f) != LVAL_LAMBDA) {
+        for (int i = 0; i < n; i++) { lval_del(xs[i]); }
+        return lval_err("First element is not a function");
+    }
+
+    /* Call with the rest as its argument list; a tail call is finished here */
+    lval* a = lval_add_n(lval_sexpr(), xs + 1, n - 1);
+    int depth = gc_depth();
+    gc_push(f);
+    gc_push(a);
+    lval* result = lval_force(lval_call(e, f, a));
+    gc_unwind(depth);
+    lval_del(f);
+    return result;
+}
+
+/*
+  Dispatch. Under GCC and Clang each handler ends by jumping straight
+  to the next one through a table of label addresses, so every
+  handler has an indirect branch of its own for the predictor to
+  learn from, instead of all sharing the one at the top of a switch.
+  Elsewhere, or with -DLISPY_NO_THREADED, it is a switch in a loop.
+*/
+#if defined(__GNUC__) && !defined(LISPY_NO_THREADED)
+#define LVM_THREADED
+#endif
+
+#ifdef LVM_THREADED
+#define LVM_CASE(op) lbl_##op:
+#define LVM_NEXT()   goto *labels[LVM_OP(ins = *ip++)]
+#else
+#define LVM_CASE(op) case op:
+#define LVM_NEXT()   break
+#endif
+
+lval* lvm_run(lenv* e, lchunk* c) {
+    lvm_reserve(c->depth);
+    lvm_enter(c);
+    int base = sp;
+    uint32_t* ip = c->code;
+    uint32_t ins;
+
+#ifdef LVM_THREADED
+    static void* const labels[] = {
+        [OP_CONST]  = &&lbl_OP_CONST,
+        [OP_GLOBAL] = &&lbl_OP_GLOBAL,
+        [OP_CALL]   = &&lbl_OP_CALL,
+        [OP_RETURN] = &&lbl_OP_RETURN,
+    };
+    LVM_NEXT();
+#else
+    for (;;) {
+        ins = *ip++;
+        switch (LVM_OP(ins)) {
+#endif
+
+        LVM_CASE(OP_CONST)
+            stack[sp++] = lval_ref(c->consts[LVM_ARG(ins)]);
+            LVM_NEXT();
+
+        LVM_CASE(OP_GLOBAL)
+            stack[sp++] = lvm_load(e, &c->globals[LVM_ARG(ins)]);
+            LVM_NEXT();
+
+        LVM_CASE(OP_CALL) {
+            /* Pop the elements before calling, a builtin may reenter */
+            int n = LVM_ARG(ins);
+            gc_poll();
+            sp -= n;
+            lval* r = lvm_apply(e, &stack[sp], n);
+            stack[sp++] = r;
+            LVM_NEXT();
+        }
+
+        LVM_CASE(OP_RETURN) {
+            lval* r = stack[--sp];
+            sp = base;
+            lvm_leave();
+            return r;
+        }
+
+#ifndef LVM_THREADED
+        }
+    }
+#endif
+}
+
+lval* lvm_eval(lenv* e, lval* v) {
+    lchunk* c = lval_compile(v);
+    if (c == NULL) { return lval_eval(e, v); }
+
+    lval_del(v);
+    lval* r = lvm_run(e, c);
+    lchunk_del(c);
+    return r;
+}
+
+void lvm_cleanup(void) {
+#ifdef LISPY_GC
+    free(running);
+    running = NULL;
+    running_cap = 0;
+#endif
+    free(stack);
+    stack = NULL;
+    stack_cap = 0;
+    sp = 0;
+}
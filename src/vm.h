@@ -0,0 +1,58 @@
+#ifndef vm_h
+#define vm_h
+
+#include <stdint.h>
+#include "lispy.h"
+
+/*
+  Bytecode. Every instruction is one 32-bit word holding the opcode
+  in its low byte and an operand in the remaining 24 bits:
+
+    OP_CONST   k   push constant k
+    OP_GLOBAL  g   push the value bound to global site g
+    OP_CALL    n   apply the top n values as an evaluated S-Expression
+    OP_RETURN      pop the result and leave the chunk
+*/
+enum { OP_CONST, OP_GLOBAL, OP_CALL, OP_RETURN };
+
+#define LVM_OP(ins)  ((ins) & 0xff)
+#define LVM_ARG(ins) ((ins) >> 8)
+#define LVM_ARG_MAX  0xffffff
+
+/* A global lookup; remembers the lenv slot it was last found in */
+typedef struct {
+    lsym sym;
+    int slot;
+} lvm_global;
+
+/* A compiled expression, in one allocation */
+typedef struct {
+    uint32_t* code;
+    int count;
+    lval** consts;
+    int consts_num;
+    lvm_global* globals;
+    int globals_num;
+    /* Most values the chunk ever has on the stack */
+    int depth;
+} lchunk;
+
+/* Compile 'v', or return NULL if it does not fit in bytecode */
+lchunk* lval_compile(lval* v);
+void lchunk_del(lchunk* c);
+
+/* Run a chunk against 'e' and return its result */
+lval* lvm_run(lenv* e, lchunk* c);
+
+/* Like lval_eval, but through the VM; falls back to the tree-walker */
+lval* lvm_eval(lenv* e, lval* v);
+
+#ifdef LISPY_GC
+/* Pass every value the VM holds to 'mark' */
+void lvm_roots(void (*mark)(lval* v));
+#endif
+
+/* Release the VM stack */
+void lvm_cleanup(void);
+
+#endif
@@ -0,0 +1,21 @@
+#!/bin/sh
+#
+# Run two builds of one test program, each leaving out a different
+# path, and compare what they print. They generate the same cases, so
+# any difference is a bug in one of the paths.
+#
+#   tests/diff.sh BINARY OTHER
+#
+
+a=$(mktemp)
+b=$(mktemp)
+trap 'rm -f "$a" "$b"' EXIT
+
+"$1" > "$a" || { echo "FAIL $1 exit $?"; exit 1; }
+"$2" > "$b" || { echo "FAIL $2 exit $?"; exit 1; }
+if ! cmp -s "$a" "$b"; then
+    echo "FAIL $1 and $2 differ"
+    diff "$a" "$b" | head -20
+    exit 1
+fi
+echo "$1 and $2: $(wc -l < "$a") lines agree"
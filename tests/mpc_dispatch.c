@@ -0,0 +1,190 @@
+#define _POSIX_C_SOURCE 200809L
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/mpc.h"
+
+/*
+  Differential test of first character dispatch in mpc 'or'. Inputs
+  generated from the tokens of each grammar, most of them malformed,
+  are parsed over and over, so skipped alternatives replay their kept
+  errors, and again after mpc_undefine, mpc_define and mpc_optimise
+  have left the tables out of date. The AST or the error text of
+  every parse is printed. Built as mpc_dispatch and as
+  mpc_dispatch_ordered with -DMPC_NO_DISPATCH, which tries every
+  alternative in order; the two must print the same.
+*/
+
+enum { INPUTS = 400, TOKENS_MAX = 12, PASSES = 2 };
+
+static unsigned long seed = 88172645463325252ul;
+
+/* xorshift, so every build generates the same cases */
+static unsigned long rnd(unsigned long n) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed % n;
+}
+
+static const char* lispy_tokens[] = {
+    "(", ")", "{", "}", "12", "-3", "x", "+", "def", " ", " ", "\n",
+    "\"s\"", "#\\a", "'", "[", "]", ";c\n", "$", "-",
+};
+
+static const char* mixed_tokens[] = {
+    "let", "lambda", "lam", "A", "a", "e", "Z", "^", "?", "!", ";",
+    "1", "le", " ", "q", "x", "y", "xxy",
+};
+
+static char* gen_input(const char** tokens, int n) {
+    char* s = malloc(TOKENS_MAX * 8 + 1);
+    s[0] = '\0';
+    int k = (int)rnd(TOKENS_MAX + 1);
+    for (int j = 0; j < k; j++) { strcat(s, tokens[rnd(n)]); }
+    return s;
+}
+
+static void print_ast(const char* s, mpc_parser_t* p) {
+    mpc_result_t r;
+    if (mpc_parse("<test>", s, p, &r)) {
+        mpc_ast_print(r.output);
+        mpc_ast_delete(r.output);
+    } else {
+        char* e = mpc_err_string(r.error);
+        printf("error %s", e);
+        free(e);
+        mpc_err_delete(r.error);
+    }
+}
+
+static void print_str(const char* s, mpc_parser_t* p) {
+    mpc_result_t r;
+    if (mpc_parse("<test>", s, p, &r)) {
+        printf("ok '%s'\n", (char*)r.output);
+        free(r.output);
+    } else {
+        char* e = mpc_err_string(r.error);
+        printf("error %s", e);
+        free(e);
+        mpc_err_delete(r.error);
+    }
+}
+
+/* Each input PASSES times, as a skipped alternative errs differently the first time */
+static void run(const char* what, char** inputs, mpc_parser_t* p,
+                void (*print)(const char*, mpc_parser_t*)) {
+    printf("== %s\n", what);
+    for (int pass = 0; pass < PASSES; pass++) {
+        for (int j = 0; j < INPUTS; j++) {
+            printf("'%s'\n", inputs[j]);
+            print(inputs[j], p);
+        }
+    }
+}
+
+static int is_vowel(char c) { return strchr("aeiou", c) && c; }
+static int is_upper(char c) { return isupper((unsigned char)c); }
+
+/* Keywords, lookahead, anchors, a repeat that fails after it and a nullable tail */
+static mpc_parser_t* mixed_parser(void) {
+    mpc_parser_t* item = mpc_or(8,
+        mpc_string("let"),
+        mpc_expect(mpc_string("lambda"), "a lambda"),
+        mpc_and(2, mpcf_snd_free,
+            mpc_not_lift(mpc_char('Z'), free, mpcf_ctor_str),
+            mpc_expect(mpc_satisfy(is_upper), "a capital"), free),
+        mpc_expect(mpc_satisfy(is_vowel), "a vowel"),
+        mpc_and(2, mpcf_snd_free, mpc_soi(), mpc_char('^'), free),
+        mpc_char(';'),
+        mpc_and(2, mpcf_strfold,
+            mpc_many(mpcf_strfold, mpc_char('x')), mpc_char('y'), free),
+        mpc_tok(mpc_char('1')));
+    return mpc_and(3, mpcf_strfold,
+        mpc_many(mpcf_strfold, item),
+        mpc_or(2, mpc_char('!'), mpc_maybe_lift(mpc_char('?'), mpcf_ctor_str)),
+        mpc_and(2, mpcf_snd_free, mpc_eoi(), mpc_lift(mpcf_ctor_str), free),
+        free, free);
+}
+
+int main(void) {
+    char* lispy_inputs[INPUTS];
+    char* mixed_inputs[INPUTS];
+    int nl = sizeof lispy_tokens / sizeof lispy_tokens[0];
+    int nm = sizeof mixed_tokens / sizeof mixed_tokens[0];
+    for (int j = 0; j < INPUTS; j++) {
+        lispy_inputs[j] = gen_input(lispy_tokens, nl);
+        mixed_inputs[j] = gen_input(mixed_tokens, nm);
+    }
+
+    mpc_parser_t* Number  = mpc_new("number");
+    mpc_parser_t* Symbol  = mpc_new("symbol");
+    mpc_parser_t* String  = mpc_new("string");
+    mpc_parser_t* Char    = mpc_new("char");
+    mpc_parser_t* Comment = mpc_new("comment");
+    mpc_parser_t* Quote   = mpc_new("quote");
+    mpc_parser_t* Vector  = mpc_new("vector");
+    mpc_parser_t* Sexpr   = mpc_new("sexpr");
+    mpc_parser_t* Qexpr   = mpc_new("qexpr");
+    mpc_parser_t* Expr    = mpc_new("expr");
+    mpc_parser_t* Lispy   = mpc_new("lispy");
+
+    mpc_err_t* err = mpca_lang(MPCA_LANG_DEFAULT,
+        "number  : /-?[0-9]+/ ;                                  "
+        "symbol  : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&%\\^]+/ ;           "
+        "string  : /\"(\\\\.|[^\"])*\"/ ;                          "
+        "char    : /#\\\\[a-z]+/ ;                                "
+        "comment : /;[^\\r\\n]*/ ;                                "
+        "quote   : '\\'' <expr> ;                                 "
+        "vector  : '[' <expr>* ']' ;                             "
+        "sexpr   : '(' <expr>* ')' ;                             "
+        "qexpr   : '{' <expr>* '}' ;                             "
+        "expr    : <string> | <char> | <comment> | <quote> | <vector>"
+        "        | <number> | <symbol> | <sexpr> | <qexpr> ;     "
+        "lispy   : /^/ <expr>* /$/ ;                             ",
+        Number, Symbol, String, Char, Comment, Quote, Vector,
+        Sexpr, Qexpr, Expr, Lispy);
+    if (err) {
+        mpc_err_print(err);
+        mpc_err_delete(err);
+        return 1;
+    }
+
+    run("lispy", lispy_inputs, Lispy, print_ast);
+
+    /* Each of these leaves every table out of date */
+    mpc_undefine(Number);
+    run("number undefined", lispy_inputs, Lispy, print_ast);
+
+    /* Digits now start a number again, though the tables say they cannot */
+    mpc_define(Number, mpca_tag(mpc_apply(
+        mpc_expect(mpc_many1(mpcf_strfold, mpc_digit()), "a natural"),
+        mpcf_str_ast), "regex"));
+    run("number redefined", lispy_inputs, Lispy, print_ast);
+
+    /* mpca_lang defines an undefined retained parser too */
+    mpc_undefine(Vector);
+    err = mpca_lang(MPCA_LANG_DEFAULT,
+        "vector : '[' (<number> | <symbol>)* ']' | '#' <qexpr> ;",
+        Vector, Number, Symbol, Qexpr);
+    if (err) { mpc_err_print(err); mpc_err_delete(err); return 1; }
+    run("vector redefined", lispy_inputs, Lispy, print_ast);
+
+    mpc_optimise(Lispy);
+    run("optimised", lispy_inputs, Lispy, print_ast);
+
+    mpc_parser_t* mixed = mixed_parser();
+    run("mixed", mixed_inputs, mixed, print_str);
+    mpc_optimise(mixed);
+    run("mixed optimised", mixed_inputs, mixed, print_str);
+    mpc_delete(mixed);
+
+    mpc_cleanup(11, Number, Symbol, String, Char, Comment, Quote, Vector,
+                Sexpr, Qexpr, Expr, Lispy);
+    for (int j = 0; j < INPUTS; j++) {
+        free(lispy_inputs[j]);
+        free(mixed_inputs[j]);
+    }
+    return 0;
+}
@@ -0,0 +1,307 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../src/mpc.h"
+
+/*
+  The inputs besides plain strings, each against the same text parsed
+  by mpc_parse, which must give the same match or error:
+  mpc_parse_contents on a regular file, which is mapped, and on an
+  empty file, /dev/null and a FIFO, none of which can be; FILE and
+  pipe input with tokens, and a rewind, across the edge of the 64 KB
+  window; where a FILE is left after a parse that stops short; and
+  mpc_nparse on NUL bytes and on a buffer that ends at an unreadable
+  page, so any read past its length faults.
+*/
+
+enum { CHUNK = 64 * 1024 };
+
+static int passed = 0, failed = 0;
+
+static void check(int ok, const char* what) {
+    if (ok) {
+        passed++;
+    } else {
+        failed++;
+        printf("FAIL %s\n", what);
+    }
+}
+
+/* "ok <output>" or "error <text>" */
+static char* result(int ok, mpc_result_t* r) {
+    char* s;
+    if (ok) {
+        s = malloc(strlen(r->output) + 4);
+        sprintf(s, "ok %s", (char*)r->output);
+        free(r->output);
+    } else {
+        char* e = mpc_err_string(r->error);
+        s = malloc(strlen(e) + 7);
+        sprintf(s, "error %s", e);
+        free(e);
+        mpc_err_delete(r->error);
+    }
+    return s;
+}
+
+static char* parse_string(const char* name, const char* s, mpc_parser_t* p) {
+    mpc_result_t r;
+    return result(mpc_parse(name, s, p, &r), &r);
+}
+
+static void check_same(char* x, char* y, const char* what) {
+    check(strcmp(x, y) == 0, what);
+    free(x);
+    free(y);
+}
+
+/* A pipe with a child writing 's' into it a piece at a time */
+static FILE* feed(const char* s) {
+    int fds[2];
+    if (pipe(fds) != 0) { exit(1); }
+    if (fork() == 0) {
+        size_t n = strlen(s);
+        close(fds[0]);
+        for (size_t j = 0; j < n; j += 1000) {
+            if (write(fds[1], s + j, n - j < 1000 ? n - j : 1000) < 0) { _exit(1); }
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    return fdopen(fds[0], "r");
+}
+
+/* 's' through a file and through a pipe, each against mpc_parse */
+static void check_streams(const char* s, mpc_parser_t* p, const char* what) {
+    char msg[256];
+    mpc_result_t r;
+
+    FILE* f = tmpfile();
+    fputs(s, f);
+    rewind(f);
+    snprintf(msg, sizeof msg, "%s: file", what);
+    check_same(result(mpc_parse_file("<test>", f, p, &r), &r),
+               parse_string("<test>", s, p), msg);
+    fclose(f);
+
+    f = feed(s);
+    snprintf(msg, sizeof msg, "%s: pipe", what);
+    check_same(result(mpc_parse_pipe("<test>", f, p, &r), &r),
+               parse_string("<test>", s, p), msg);
+    fclose(f);
+    wait(NULL);
+}
+
+static void test_contents(mpc_parser_t* any, mpc_parser_t* word) {
+    mpc_result_t r;
+    char dir[] = "/tmp/mpc_input_XXXXXX";
+    char path[64];
+    const char* text = "alpha beta";
+
+    if (mkdtemp(dir) == NULL) { exit(1); }
+
+    /* Mapped, with no NUL after the end */
+    mpc_parser_t* all = mpc_and(2, mpcf_fst_free,
+        mpc_many(mpcf_strfold, mpc_re("[a-z]+ *")), mpc_eoi(), free);
+    snprintf(path, sizeof path, "%s/text", dir);
+    FILE* f = fopen(path, "w");
+    fputs(text, f);
+    fclose(f);
+    check_same(result(mpc_parse_contents(path, all, &r), &r),
+               parse_string(path, text, all), "regular file");
+    check_same(result(mpc_parse_contents(path, word, &r), &r),
+               parse_string(path, text, word), "regular file, first word");
+    unlink(path);
+    mpc_delete(all);
+
+    /* Empty, so there is nothing to map */
+    snprintf(path, sizeof path, "%s/empty", dir);
+    fclose(fopen(path, "w"));
+    check_same(result(mpc_parse_contents(path, any, &r), &r),
+               parse_string(path, "", any), "empty file");
+    check_same(result(mpc_parse_contents(path, word, &r), &r),
+               parse_string(path, "", word), "empty file, error");
+    unlink(path);
+
+    check_same(result(mpc_parse_contents("/dev/null", word, &r), &r),
+               parse_string("/dev/null", "", word), "/dev/null");
+
+    /* A FIFO is read as a FILE, with a child writing the other end */
+    snprintf(path, sizeof path, "%s/fifo", dir);
+    if (mkfifo(path, 0600) != 0) { exit(1); }
+    if (fork() == 0) {
+        FILE* w = fopen(path, "w");
+        fputs(text, w);
+        fclose(w);
+        _exit(0);
+    }
+    check_same(result(mpc_parse_contents(path, any, &r), &r),
+               parse_string(path, text, any), "fifo");
+    wait(NULL);
+    unlink(path);
+
+    snprintf(path, sizeof path, "%s/missing", dir);
+    check(!mpc_parse_contents(path, any, &r), "missing file");
+    mpc_err_delete(r.error);
+
+    rmdir(dir);
+}
+
+static void test_window(mpc_parser_t* words, mpc_parser_t* rewind_) {
+    size_t n = 3 * CHUNK;
+    char* s = malloc(n + 1);
+
+    /* Words of five letters, so some cross each multiple of 64 KB */
+    for (size_t j = 0; j < n; j++) { s[j] = j % 6 == 5 ? ' ' : 'a' + j % 7; }
+    s[n] = '\0';
+    check_streams(s, words, "words across the window");
+
+    /* One long word across two edges of the window */
+    memset(s, ' ', n);
+    memset(s + CHUNK - 10, 'q', CHUNK + 20);
+    check_streams(s, words, "long word across the window");
+
+    /* A line break just before the edge, as pipes stop at one */
+    for (size_t j = 0; j < n; j++) { s[j] = j % 6 == 5 ? ' ' : 'a' + j % 7; }
+    s[CHUNK - 2] = '\n';
+    check_streams(s, words, "line break at the window");
+
+    /* Read most of two windows, fail, and go back to the start */
+    memset(s, 'a', n);
+    s[n - 1] = 'y';
+    check_streams(s, rewind_, "rewind across the window");
+    s[n - 1] = 'x';
+    check_streams(s, rewind_, "no rewind across the window");
+
+    free(s);
+}
+
+static void test_position(mpc_parser_t* word, mpc_parser_t* as) {
+    char rest[32];
+    mpc_result_t r;
+    FILE* f = tmpfile();
+    fputs("alpha beta gamma", f);
+
+    /* Each parse goes on from where the last one stopped */
+    rewind(f);
+    check(mpc_parse_file("<test>", f, word, &r), "first word");
+    free(r.output);
+    check(ftell(f) == 6, "after the first word");
+    check(mpc_parse_file("<test>", f, word, &r), "second word");
+    check(strcmp(r.output, "beta ") == 0, "second word read");
+    free(r.output);
+    check(ftell(f) == 11, "after the second word");
+    check(fgets(rest, sizeof rest, f) && strcmp(rest, "gamma") == 0, "rest of the file");
+
+    /* From the middle of a word */
+    fseek(f, 2, SEEK_SET);
+    check(mpc_parse_file("<test>", f, word, &r), "part word");
+    check(strcmp(r.output, "pha ") == 0, "part word read");
+    free(r.output);
+    check(ftell(f) == 6, "after part of a word");
+    fclose(f);
+
+    /* Stopping in the second window, well short of the end */
+    f = tmpfile();
+    for (int j = 0; j < CHUNK + 100; j++) { fputc('a', f); }
+    fputs(" tail and more", f);
+    for (int j = 0; j < CHUNK; j++) { fputc('b', f); }
+    rewind(f);
+    check(mpc_parse_file("<test>", f, as, &r), "long run");
+    free(r.output);
+    check(ftell(f) == CHUNK + 100, "after a long run");
+    check(fgets(rest, 6, f) && strcmp(rest, " tail") == 0, "after a long run, read");
+    fclose(f);
+}
+
+/* The rest after 'p' matches, or the error */
+static char* nparse(mpc_parser_t* p, const char* s, size_t n) {
+    mpc_result_t r;
+    mpc_parser_t* q = mpc_and(2, mpcf_snd_free, p, mpc_many(mpcf_strfold, mpc_any()), free);
+    char* x = result(mpc_nparse("<test>", s, n, q, &r), &r);
+    mpc_delete(q);
+    return x;
+}
+
+static void check_nparse(char* x, const char* expected, const char* what) {
+    check(strcmp(x, expected) == 0, what);
+    if (strcmp(x, expected) != 0) { printf("  got '%s'\n", x); }
+    free(x);
+}
+
+static void test_nparse(void) {
+    const char nul[] = "ab\0cd\0\nrest";
+    size_t n = sizeof nul - 1;
+
+    check_nparse(nparse(mpc_and(4, mpcf_strfold, mpc_string("ab"), mpc_char('\0'),
+        mpc_string("cd"), mpc_char('\0'), free, free, free), nul, n),
+        "ok \nrest", "NUL read as a character");
+    check_nparse(nparse(mpc_many(mpcf_strfold, mpc_noneof("\n")), nul, n),
+        "ok \nrest", "noneof across NULs");
+    check_nparse(nparse(mpc_and(2, mpcf_strfold,
+        mpc_many(mpcf_strfold, mpc_oneof("abc")), mpc_char('\0'), free), nul, n),
+        "ok cd", "oneof stops at NUL");
+    check_nparse(nparse(mpc_re("[a-d]*.[a-d]*."), nul, n),
+        "ok \nrest", "regex across NULs");
+    check_nparse(nparse(mpc_string("a"), nul, 1), "ok ", "length ends the input");
+    check_nparse(nparse(mpc_string("ab"), nul, 1),
+        "error <test>:1:1: error: expected \"ab\" at 'a'\n", "length cuts the input");
+
+    /* The last byte of a page, with nothing readable after it */
+    long page = sysconf(_SC_PAGESIZE);
+    int fd = open("/dev/zero", O_RDONLY);
+    char* m = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED || mprotect(m + page, page, PROT_NONE) != 0) { exit(1); }
+    char* s = m + page - 5;
+    memcpy(s, "hello", 5);
+
+    check_nparse(nparse(mpc_many(mpcf_strfold, mpc_any()), s, 5),
+        "ok ", "many any to the end");
+    check_nparse(nparse(mpc_many(mpcf_strfold, mpc_noneof("z")), s, 5),
+        "ok ", "many noneof to the end");
+    check_nparse(nparse(mpc_re("[a-z]*$"), s, 5), "ok ", "regex to the end");
+    check_nparse(nparse(mpc_string("hello!"), s, 5),
+        "error <test>:1:1: error: expected \"hello!\" at 'h'\n", "string past the end");
+    check_nparse(nparse(mpc_and(2, mpcf_snd_free, mpc_string("hello"), mpc_eoi(), free), s, 5),
+        "ok ", "end of input");
+
+    munmap(m, 2 * page);
+}
+
+int main(void) {
+    /* A FIFO opened twice waits for a writer forever; fail instead */
+    alarm(60);
+
+    mpc_parser_t* any = mpc_many(mpcf_strfold, mpc_any());
+    mpc_parser_t* word = mpc_re("[a-z]+ *");
+    mpc_parser_t* as = mpc_many1(mpcf_strfold, mpc_char('a'));
+    mpc_parser_t* words = mpc_and(2, mpcf_snd_free,
+        mpc_many(mpcf_strfold, mpc_oneof(" \n")),
+        mpc_many(mpcf_strfold, mpc_or(2,
+            mpc_tok(mpc_re("[a-z]+")),
+            mpc_and(2, mpcf_snd_free, mpc_char('\n'), mpc_lift(mpcf_ctor_str), free))),
+        free);
+    mpc_parser_t* rewind_ = mpc_or(2,
+        mpc_and(2, mpcf_strfold, mpc_many1(mpcf_strfold, mpc_char('a')), mpc_char('y'), free),
+        mpc_and(2, mpcf_snd_free, mpc_many1(mpcf_strfold, mpc_any()), mpc_lift(mpcf_ctor_str), free));
+
+    test_contents(any, word);
+    test_window(words, rewind_);
+    test_position(word, as);
+    test_nparse();
+
+    mpc_delete(any);
+    mpc_delete(word);
+    mpc_delete(as);
+    mpc_delete(words);
+    mpc_delete(rewind_);
+    printf("mpc_input: %d passed, %d failed\n", passed, failed);
+    return failed != 0;
+}
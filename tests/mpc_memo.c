@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/mpc.h"
+
+/*
+  Packrat memoization. The same grammar is built with and without
+  'b' marked @memo, and every input, good or bad, must give the same
+  AST or the same error under both. 'a' tries 'b' at the front of each
+  alternative, so backtracking into it must hit the memo; with a budget
+  of a few entries the memo must evict and still give the same result.
+  The boundary before 'y' looks at the character 'b' ended on, which a
+  replay must restore too. Hits and evictions are read from mpc_stats.
+*/
+
+static const char* plain =
+    "top : /^/ <a>* /$/ ;"
+    "a : <b> 'x' | <b> /\\b/ 'y' | <b> ;"
+    "b : '(' <a> ')' | 'z' ;";
+
+static const char* memo =
+    "top : /^/ <a>* /$/ ;"
+    "a : <b> 'x' | <b> /\\b/ 'y' | <b> ;"
+    "b @memo : '(' <a> ')' | 'z' ;";
+
+static const char* inputs[] = {
+    "z", "zx", "zy", "(z)", "((z)x)y", "(((z)))", "((((z)y)x)y)",
+    "zzxzy(z)", "(z)(zx)((z)y)", "(zy)", "z(z)y", "zz)y",
+    "", "x", "(z", "((z)", "(z))", "((z)q)", "zz(zx", "(((((z)x)y)",
+};
+
+enum { INPUTS = sizeof inputs / sizeof inputs[0] };
+
+static int passed = 0, failed = 0;
+
+static void check(int ok, const char* what, const char* input) {
+    if (ok) {
+        passed++;
+    } else {
+        failed++;
+        printf("FAIL %s: '%s'\n", what, input);
+    }
+}
+
+typedef struct {
+    mpc_parser_t* top;
+    mpc_parser_t* a;
+    mpc_parser_t* b;
+} grammar;
+
+static grammar grammar_new(const char* lang) {
+    grammar g = { mpc_new("top"), mpc_new("a"), mpc_new("b") };
+    mpc_err_t* err = mpca_lang(MPCA_LANG_DEFAULT, lang, g.top, g.a, g.b, NULL);
+    if (err) {
+        mpc_err_print(err);
+        exit(1);
+    }
+    return g;
+}
+
+static void grammar_delete(grammar* g) {
+    mpc_cleanup(3, g->top, g->a, g->b);
+}
+
+/* The AST printed, or the error text */
+static char* parse(grammar* g, const char* s) {
+    mpc_result_t r;
+    char* out;
+    size_t n;
+    FILE* f = tmpfile();
+    if (mpc_parse("<test>", s, g->top, &r)) {
+        mpc_ast_print_to(r.output, f);
+        mpc_ast_delete(r.output);
+    } else {
+        mpc_err_print_to(r.error, f);
+        mpc_err_delete(r.error);
+    }
+    n = (size_t)ftell(f);
+    out = calloc(n + 1, 1);
+    rewind(f);
+    if (fread(out, 1, n, f) != n) { exit(1); }
+    fclose(f);
+    return out;
+}
+
+/* A line of mpc_stats for 'g', found by its prefix */
+static unsigned long stat(grammar* g, const char* prefix) {
+    char line[256];
+    unsigned long x = 0;
+    FILE* f = tmpfile();
+    int out = dup(STDOUT_FILENO);
+    fflush(stdout);
+    dup2(fileno(f), STDOUT_FILENO);
+    mpc_stats(g->top);
+    fflush(stdout);
+    dup2(out, STDOUT_FILENO);
+    close(out);
+    rewind(f);
+    while (fgets(line, sizeof line, f)) {
+        if (strncmp(line, prefix, strlen(prefix)) == 0) {
+            x = strtoul(line + strlen(prefix), NULL, 10);
+        }
+    }
+    fclose(f);
+    return x;
+}
+
+/* Every input under 'm' as under 'p' */
+static void compare(grammar* p, grammar* m, const char* what) {
+    for (int j = 0; j < INPUTS; j++) {
+        char* x = parse(p, inputs[j]);
+        char* y = parse(m, inputs[j]);
+        check(strcmp(x, y) == 0, what, inputs[j]);
+        free(x);
+        free(y);
+    }
+}
+
+int main(void) {
+    grammar p = grammar_new(plain);
+    grammar m = grammar_new(memo);
+
+    compare(&p, &m, "memoized");
+    check(stat(&m, "Memo Hits: ") > 0, "no memo hits", "");
+    check(stat(&m, "Memo Evicted: ") == 0, "evicted under the default budget", "");
+    grammar_delete(&m);
+
+    /* Room for a handful of entries, so most parses go over it */
+    size_t prev = mpc_memo_set_budget(1024);
+    m = grammar_new(memo);
+    compare(&p, &m, "memoized over budget");
+    check(stat(&m, "Memo Hits: ") > 0, "no memo hits over budget", "");
+    check(stat(&m, "Memo Evicted: ") > 0, "nothing evicted over budget", "");
+    grammar_delete(&m);
+    mpc_memo_set_budget(prev);
+
+    grammar_delete(&p);
+    printf("mpc_memo: %d passed, %d failed\n", passed, failed);
+    return failed != 0;
+}
@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/mpc.h"
+
+/*
+  Randomized differential test of mpc_re. Generated regexes are run on
+  generated inputs through string, FILE and pipe inputs, and for each
+  the match or the error, and how far it read, are printed. Built as
+  mpc_regex with the compiled tables and as mpc_regex_nodfa with
+  -DMPC_NO_DFA, which leaves every regex on the combinators; the two
+  must print the same.
+*/
+
+enum { REGEXES = 3000, INPUTS = 8, INPUT_MAX = 10 };
+
+static unsigned long seed = 88172645463325252ul;
+
+/* xorshift, so every build generates the same cases */
+static unsigned long rnd(unsigned long n) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed % n;
+}
+
+static const char* atoms[] = {
+    "a", "b", "c", "0", "1", " ", ".", "[ab]", "[^a]", "[a-c]", "[0-9]",
+    "[^ ]", "\\d", "\\s", "\\w", "\\.", "\\D", "\\b",
+};
+
+/* The last two match empty: mpc's \D only looks, like \b */
+enum { ATOMS = sizeof atoms / sizeof atoms[0], NULLABLE_ATOMS = 2 };
+
+static const char* repeats[] = { "?", "*", "+", "{2}", "{3}" };
+
+/**
+ * Append a random regex to 're'; returns 1 if it can match empty.
+ * Only what cannot is repeated, as mpc's 'many' would loop forever.
+ **/
+static int gen(char* re, int depth) {
+    int k = (int)rnd(depth > 2 ? 4 : 8);
+    int nullable;
+    if (k < 4) {
+        int a = (int)rnd(ATOMS);
+        strcat(re, atoms[a]);
+        nullable = a >= ATOMS - NULLABLE_ATOMS;
+    } else if (k < 6) {
+        /* A repeat after this would bind to its last part alone */
+        int n = 1 + (int)rnd(3);
+        nullable = 1;
+        for (int j = 0; j < n; j++) { nullable &= gen(re, depth + 1); }
+        return nullable;
+    } else if (k == 6) {
+        strcat(re, "(");
+        nullable = gen(re, depth + 1);
+        strcat(re, "|");
+        nullable |= gen(re, depth + 1);
+        strcat(re, ")");
+    } else {
+        strcat(re, "(");
+        nullable = gen(re, depth + 1);
+        strcat(re, ")");
+    }
+    if (rnd(3) == 0) {
+        int j = (int)rnd(nullable ? 1 : sizeof repeats / sizeof repeats[0]);
+        strcat(re, repeats[j]);
+        nullable |= j < 2;
+    }
+    return nullable;
+}
+
+static void gen_regex(char* re) {
+    re[0] = '\0';
+    if (rnd(6) == 0) { strcat(re, "^"); }
+    gen(re, 0);
+    if (rnd(3) == 0) {
+        strcat(re, "|");
+        gen(re, 1);
+    }
+    if (rnd(6) == 0) { strcat(re, "$"); }
+}
+
+static void gen_input(char* s) {
+    static const char chars[] = "abc01 .";
+    int n = (int)rnd(INPUT_MAX + 1);
+    for (int j = 0; j < n; j++) { s[j] = chars[rnd(sizeof chars - 1)]; }
+    s[n] = '\0';
+}
+
+/* The match and everything after it, as "match|rest" */
+static mpc_val_t* fold_split(int n, mpc_val_t** xs) {
+    char* m = xs[0];
+    char* rest = xs[1];
+    char* s = malloc(strlen(m) + strlen(rest) + 2);
+    sprintf(s, "%s|%s", m, rest);
+    free(m);
+    free(rest);
+    return s;
+}
+
+static void print_result(const char* how, int ok, mpc_result_t* r) {
+    if (ok) {
+        printf("  %s ok '%s'\n", how, (char*)r->output);
+        free(r->output);
+    } else {
+        char* e = mpc_err_string(r->error);
+        printf("  %s error %s", how, e);
+        free(e);
+        mpc_err_delete(r->error);
+    }
+}
+
+int main(void) {
+    char re[4096], input[INPUT_MAX + 1];
+    mpc_result_t r;
+
+    for (int j = 0; j < REGEXES; j++) {
+        gen_regex(re);
+        mpc_parser_t* p = mpc_re(re);
+        mpc_parser_t* split = mpc_and(2, fold_split,
+            p, mpc_many(mpcf_strfold, mpc_any()), free);
+        printf("/%s/\n", re);
+
+        for (int k = 0; k < INPUTS; k++) {
+            gen_input(input);
+            printf(" '%s'\n", input);
+
+            print_result("string", mpc_parse("<test>", input, p, &r), &r);
+            print_result("split", mpc_parse("<test>", input, split, &r), &r);
+
+            /* FILE and pipe inputs, and where each leaves the stream */
+            FILE* f = tmpfile();
+            fputs(input, f);
+            rewind(f);
+            print_result("file", mpc_parse_file("<test>", f, p, &r), &r);
+            printf("  file at %ld\n", ftell(f));
+            rewind(f);
+            print_result("pipe", mpc_parse_pipe("<test>", f, p, &r), &r);
+            fclose(f);
+        }
+
+        mpc_delete(split);
+    }
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Run every tests/*.lspy through BINARY with FLAGS and compare what it
+# prints with the .expected file beside it. Exiting nonzero fails the
+# script too, as an AddressSanitizer build does when anything leaks.
+# Each script runs again with --fold added, as folding must not change
+# what any of them prints. With -d the scripts come from DIR instead.
+#
+#   tests/run.sh [-d DIR] BINARY [FLAGS...]
+#
+
+dir=$(dirname "$0")
+if [ "$1" = "-d" ]; then
+    dir=$2
+    shift 2
+fi
+bin=$1
+shift
+out=$(mktemp)
+err=$(mktemp)
+trap 'rm -f "$out" "$err"' EXIT
+
+case " $* " in
+    *" --fold "*) folds="" ;;
+    *) folds="--fold" ;;
+esac
+
+failed=0
+for fold in "" $folds; do
+    run="$dir: $bin${*:+ $*}${fold:+ $fold}"
+    pass=0
+    fail=0
+    for t in "$dir"/*.lspy; do
+        name=$(basename "$t" .lspy)
+        "$bin" "$@" $fold "$t" > "$out" 2> "$err"
+        status=$?
+        if [ $status -eq 0 ] && cmp -s "$out" "$dir/$name.expected"; then
+            pass=$((pass + 1))
+            continue
+        fi
+        fail=$((fail + 1))
+        echo "FAIL $name [$run] exit $status"
+        diff "$dir/$name.expected" "$out" | head -20
+        grep -v '^; folded' "$err" | head -20
+    done
+    echo "$run: $pass passed, $fail failed"
+    [ $fail -eq 0 ] || failed=1
+done
+
+[ $failed -eq 0 ]